@@ -63,3 +63,15 @@ scratch_storage_upsert(uint32_t key_offset, uint32_t key_len, uint32_t value_off
 {
 	sledge_abi__scratch_storage_upsert(key_offset, key_len, value_offset, value_len);
 }
+
+/**
+ * Places the body of the HTTP request in linear memory without copying it through stdin
+ * @param offset_retoffset linear memory offset where the offset of the body is written
+ * @param length_retoffset linear memory offset where the length of the body is written
+ * @returns 0 on success, 1 on error
+ */
+INLINE int
+request_body_get(uint32_t offset_retoffset, uint32_t length_retoffset)
+{
+	return sledge_abi__request_body_get(offset_retoffset, length_retoffset);
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <arm_neon.h>
+#include <stdint.h>
+
+/**
+ * Skips 16-byte blocks that contain neither a nor b
+ * @returns the first match, or the start of the block that is too short to load
+ */
+static inline const char *
+arch_http_scan_either(const char *cursor, const char *end, char a, char b)
+{
+	const uint8x16_t match_a = vdupq_n_u8((uint8_t)a);
+	const uint8x16_t match_b = vdupq_n_u8((uint8_t)b);
+
+	while (end - cursor >= 16) {
+		uint8x16_t block   = vld1q_u8((const uint8_t *)cursor);
+		uint8x16_t matches = vorrq_u8(vceqq_u8(block, match_a), vceqq_u8(block, match_b));
+
+		/* Narrow each byte of the comparison to a nibble, giving a 64-bit mask with 4 bits per byte */
+		uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(matches), 4)), 0);
+		if (mask != 0) return cursor + (__builtin_ctzll(mask) >> 2);
+		cursor += 16;
+	}
+
+	return cursor;
+}
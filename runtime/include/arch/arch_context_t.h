@@ -1,15 +1,30 @@
 #pragma once
 
 #include <setjmp.h>
+#include <stddef.h>
 #include <ucontext.h>
 
 #include "arch/arch_context_variant_t.h"
 #include "arch/reg_t.h"
 #include "arch/ureg_t.h"
 
+#if !defined(AARCH64) && !defined(aarch64)
+/*
+ * On x86_64, the mcontext only points at the floating point and vector state, which the kernel saves in the signal
+ * frame on the alternate stack of the worker that took the signal. Every later signal on that worker reuses the
+ * stack and overwrites the frame, so a slowpath context keeps its own copy of the state and restores it into the frame
+ * of the signal that resumes it. Large enough for the XSAVE frame of AVX-512 processors
+ */
+#define ARCH_CONTEXT_FPSTATE_SIZE 4096
+#endif
+
 struct arch_context {
 	arch_context_variant_t variant;
 	reg_t                  regs[UREG_COUNT];
 	mcontext_t             mctx;
 	jmp_buf                start_buf;
+#if !defined(AARCH64) && !defined(aarch64)
+	size_t  fpstate_size;
+	uint8_t fpstate[ARCH_CONTEXT_FPSTATE_SIZE] __attribute__((aligned(64)));
+#endif
 };
@@ -12,6 +12,7 @@
 #include "arch/arch_context_variant_t.h"
 #include "arch/reg_t.h"
 #include "arch/ureg_t.h"
+#include "likely.h"
 #include "software_interrupt.h"
 #include "worker_thread.h"
 
@@ -31,6 +31,26 @@
 #endif
 
 
+#if defined(X86_64) || defined(x86_64)
+/* Software-reserved bytes the kernel writes at the end of the legacy FXSAVE area, see struct _fpx_sw_bytes */
+#define ARCH_CONTEXT_FPX_SW_BYTES_OFFSET 464
+#define ARCH_CONTEXT_FP_XSTATE_MAGIC1    0x46505853U
+
+/**
+ * @param fpregs the floating point state of a signal frame
+ * @returns the bytes of the state, which extend past the FXSAVE area when the kernel saved it with XSAVE
+ */
+static inline size_t
+arch_context_fpstate_size(const struct _libc_fpstate *fpregs)
+{
+	const uint32_t *sw_bytes = (const uint32_t *)((const uint8_t *)fpregs + ARCH_CONTEXT_FPX_SW_BYTES_OFFSET);
+
+	/* magic1, then extended_size, which covers the XSAVE area and its trailing magic2 */
+	if (sw_bytes[0] == ARCH_CONTEXT_FP_XSTATE_MAGIC1) return sw_bytes[1];
+	return sizeof(struct _libc_fpstate);
+}
+#endif
+
 /**
  * Restore a full mcontext
  * Writes sandbox_context to active_context
@@ -52,7 +72,19 @@ arch_context_restore_slow(mcontext_t *active_context, struct arch_context *conte
 	context_to_restore->variant = ARCH_CONTEXT_VARIANT_RUNNING;
 
 	/* Restore mcontext */
+#if defined(X86_64) || defined(x86_64)
+	/* Keep pointing at the floating point state in the frame of this signal, and fill it from the saved copy */
+	fpregset_t fpregs = active_context->fpregs;
+	memcpy(active_context, &context_to_restore->mctx, sizeof(mcontext_t));
+	active_context->fpregs = fpregs;
+	if (fpregs != NULL && context_to_restore->fpstate_size > 0) {
+		if (unlikely(arch_context_fpstate_size(fpregs) != context_to_restore->fpstate_size))
+			panic("Signal frame floating point state does not match the preempted context\n");
+		memcpy(fpregs, context_to_restore->fpstate, context_to_restore->fpstate_size);
+	}
+#else
 	memcpy(active_context, &context_to_restore->mctx, sizeof(mcontext_t));
+#endif
 }
 
 
@@ -76,4 +108,16 @@ arch_context_save_slow(struct arch_context *sandbox_context, const mcontext_t *a
 
 	/* Copy mcontext */
 	memcpy(&sandbox_context->mctx, active_context, sizeof(mcontext_t));
+#if defined(X86_64) || defined(x86_64)
+	/* The floating point state lives in the signal frame, which the next signal on this worker overwrites */
+	sandbox_context->fpstate_size = 0;
+	if (active_context->fpregs != NULL) {
+		size_t fpstate_size = arch_context_fpstate_size(active_context->fpregs);
+		if (unlikely(fpstate_size > ARCH_CONTEXT_FPSTATE_SIZE))
+			panic("Signal frame floating point state of %zu bytes exceeds %d\n", fpstate_size,
+			      ARCH_CONTEXT_FPSTATE_SIZE);
+		memcpy(sandbox_context->fpstate, active_context->fpregs, fpstate_size);
+		sandbox_context->fpstate_size = fpstate_size;
+	}
+#endif
 }
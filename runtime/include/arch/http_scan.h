@@ -0,0 +1,35 @@
+#pragma once
+
+/*
+ * Byte scanning used by the HTTP request parser. The architecture headers compare 16 bytes at a time using the
+ * vector unit that is always available on that architecture, SSE2 on x86_64 and NEON on aarch64, so no -march
+ * flags are needed. They skip whole blocks that contain no match and leave the final partial block to the scalar
+ * loop below.
+ */
+#if defined(AARCH64) || defined(aarch64)
+#include "aarch64/http_scan.h"
+#elif defined(X86_64) || defined(x86_64)
+#include "x86_64/http_scan.h"
+#else
+#warning "Architecture not set. Using x86_64"
+#define X86_64
+#include "x86_64/http_scan.h"
+#endif
+
+/**
+ * Finds the first occurrence of either of two bytes
+ * @param cursor start of the range
+ * @param end one past the end of the range
+ * @param a
+ * @param b may equal a to search for a single byte
+ * @returns pointer to the first match, or NULL if neither byte is in the range
+ */
+static inline const char *
+http_scan_either(const char *cursor, const char *end, char a, char b)
+{
+	for (cursor = arch_http_scan_either(cursor, end, a, b); cursor < end; cursor++) {
+		if (*cursor == a || *cursor == b) return cursor;
+	}
+
+	return NULL;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <emmintrin.h>
+
+/**
+ * Skips 16-byte blocks that contain neither a nor b
+ * @returns the first match, or the start of the block that is too short to load
+ */
+static inline const char *
+arch_http_scan_either(const char *cursor, const char *end, char a, char b)
+{
+	const __m128i match_a = _mm_set1_epi8(a);
+	const __m128i match_b = _mm_set1_epi8(b);
+
+	while (end - cursor >= 16) {
+		__m128i block = _mm_loadu_si128((const __m128i *)cursor);
+		int     mask  = _mm_movemask_epi8(
+		  _mm_or_si128(_mm_cmpeq_epi8(block, match_a), _mm_cmpeq_epi8(block, match_b)));
+		if (mask != 0) return cursor + __builtin_ctz((unsigned int)mask);
+		cursor += 16;
+	}
+
+	return cursor;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "likely.h"
+
+/*
+ * A bump arena for host-side scratch memory with a short, known lifetime, such as the host copies of iovec arrays
+ * a hostcall builds and the WASI context of a sandbox. Allocating is a pointer bump into an inline buffer, and memory
+ * is only given back all at once, either to a mark taken before a hostcall or by resetting the arena when its owner
+ * completes. Requests that do not fit in the inline buffer fall back to the allocator, and those blocks are freed
+ * the same way.
+ */
+
+#define ARENA_CAPACITY  2048
+#define ARENA_ALIGNMENT 16
+
+struct arena_overflow {
+	struct arena_overflow *next;
+	max_align_t            data[];
+};
+
+struct arena_mark {
+	size_t                 used;
+	struct arena_overflow *overflow;
+};
+
+struct arena {
+	size_t                 used;
+	struct arena_overflow *overflow; /* Most recent first */
+	uint8_t                buffer[ARENA_CAPACITY] __attribute__((aligned(ARENA_ALIGNMENT)));
+};
+
+/* A zeroed arena is empty, so arena_init is only needed for an arena that was not zeroed */
+static inline void
+arena_init(struct arena *arena)
+{
+	arena->used     = 0;
+	arena->overflow = NULL;
+}
+
+/**
+ * @param arena
+ * @param size bytes to allocate
+ * @returns uninitialized memory aligned to ARENA_ALIGNMENT, or NULL on allocation failure
+ */
+static inline void *
+arena_alloc(struct arena *arena, size_t size)
+{
+	assert(arena != NULL);
+
+	size_t aligned_size = (size + ARENA_ALIGNMENT - 1) & ~((size_t)ARENA_ALIGNMENT - 1);
+	if (likely(aligned_size <= ARENA_CAPACITY - arena->used)) {
+		void *allocation = &arena->buffer[arena->used];
+		arena->used += aligned_size;
+		return allocation;
+	}
+
+	struct arena_overflow *overflow = malloc(sizeof(struct arena_overflow) + size);
+	if (unlikely(overflow == NULL)) return NULL;
+
+	overflow->next  = arena->overflow;
+	arena->overflow = overflow;
+	return overflow->data;
+}
+
+/**
+ * Records the arena's current extent, so that everything allocated after can be released with arena_release
+ */
+static inline struct arena_mark
+arena_mark(struct arena *arena)
+{
+	return (struct arena_mark){ .used = arena->used, .overflow = arena->overflow };
+}
+
+/**
+ * Releases every allocation made since the mark was taken
+ */
+static inline void
+arena_release(struct arena *arena, struct arena_mark mark)
+{
+	assert(mark.used <= arena->used);
+
+	while (arena->overflow != mark.overflow) {
+		assert(arena->overflow != NULL);
+		struct arena_overflow *next = arena->overflow->next;
+		free(arena->overflow);
+		arena->overflow = next;
+	}
+
+	arena->used = mark.used;
+}
+
+/**
+ * Releases every allocation, leaving the arena empty
+ */
+static inline void
+arena_reset(struct arena *arena)
+{
+	arena_release(arena, (struct arena_mark){ .used = 0, .overflow = NULL });
+}
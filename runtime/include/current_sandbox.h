@@ -49,7 +49,7 @@ current_sandbox_set(struct sandbox *sandbox)
 		};
 		worker_thread_current_sandbox = NULL;
 		/* This is because the event core does not maintain core-assigned deadline */
-		if (!listener_thread_is_running()) runtime_worker_threads_deadline[worker_thread_idx] = UINT64_MAX;
+		if (!listener_thread_is_running()) runtime_worker_slots[worker_thread_idx].deadline = UINT64_MAX;
 	} else {
 		sledge_abi__current_wasm_module_instance.wasi_context = sandbox->wasi_context;
 		memcpy(&sledge_abi__current_wasm_module_instance.abi.memory, &sandbox->memory->abi,
@@ -58,12 +58,17 @@ current_sandbox_set(struct sandbox *sandbox)
 		wasm_globals_update_if_used(&sandbox->globals, 0,
 		                            &sledge_abi__current_wasm_module_instance.abi.wasmg_0);
 		worker_thread_current_sandbox = sandbox;
-		if (!listener_thread_is_running())
-			runtime_worker_threads_deadline[worker_thread_idx] = sandbox->absolute_deadline;
+		if (!listener_thread_is_running()) {
+			struct runtime_worker_slot *slot = &runtime_worker_slots[worker_thread_idx];
+			slot->deadline                   = sandbox->absolute_deadline;
+			slot->remaining_exec             = sandbox->remaining_exec;
+		}
 	}
 }
 
 extern void current_sandbox_sleep();
+extern int  current_sandbox_wait_for_request_body(int offset);
+extern int  current_sandbox_send_response_chunk(void);
 
 static inline void *
 current_sandbox_get_ptr_void(uint32_t offset, uint32_t bounds_check)
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <threads.h>
 
 #include "sandbox_types.h"
 
@@ -17,6 +18,8 @@ struct global_request_scheduler_config {
 	global_request_scheduler_peek_fn_t              peek_fn;
 };
 
+/* The NUMA node of the global queue that the calling listener last added a request to */
+extern thread_local int global_request_scheduler_last_node;
 
 void            global_request_scheduler_initialize(struct global_request_scheduler_config *config);
 struct sandbox *global_request_scheduler_add(struct sandbox *);
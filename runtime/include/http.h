@@ -10,55 +10,70 @@
 #define HTTP_MAX_HEADER_VALUE_LENGTH 256
 #define HTTP_MAX_FULL_URL_LENGTH     256
 
-#define HTTP_MAX_QUERY_PARAM_COUNT  16
-#define HTTP_MAX_QUERY_PARAM_LENGTH 32
+#define HTTP_MAX_QUERY_PARAM_COUNT 16
+
+/* Bound on the request line and headers, matching the default of the http-parser library this replaced */
+#define HTTP_MAX_HEAD_LENGTH (80 * 1024)
+
+enum http_method
+{
+	HTTP_METHOD_UNKNOWN = 0,
+	HTTP_METHOD_GET,
+	HTTP_METHOD_HEAD,
+	HTTP_METHOD_POST,
+	HTTP_METHOD_PUT,
+	HTTP_METHOD_DELETE,
+	HTTP_METHOD_CONNECT,
+	HTTP_METHOD_OPTIONS,
+	HTTP_METHOD_TRACE,
+	HTTP_METHOD_PATCH
+};
 
 #define HTTP_RESPONSE_CONTENT_TYPE      "Content-Type: %s\r\n"
 #define HTTP_RESPONSE_CONTENT_LENGTH    "Content-Length: %lu\r\n"
+#define HTTP_RESPONSE_CHUNKED           "Transfer-Encoding: chunked\r\n"
+#define HTTP_RESPONSE_CHUNK_SIZE        "%zx\r\n"
+#define HTTP_RESPONSE_LAST_CHUNK        "0\r\n\r\n"
 #define HTTP_RESPONSE_TERMINATOR        "\r\n"
 #define HTTP_RESPONSE_TERMINATOR_LENGTH 2
 
+#define HTTP_RESPONSE_CONNECTION_CLOSE      "Connection: close\r\n"
+#define HTTP_RESPONSE_CONNECTION_KEEP_ALIVE "Connection: keep-alive\r\n"
+
 #define HTTP_RESPONSE_200_OK  \
 	"HTTP/1.1 200 OK\r\n" \
-	"Server: SLEdge\r\n"  \
-	"Connection: close\r\n"
-#define HTTP_RESPONSE_200_OK_LENGTH 52
+	"Server: SLEdge\r\n"
+#define HTTP_RESPONSE_200_OK_LENGTH 33
 
 #define HTTP_RESPONSE_400_BAD_REQUEST  \
 	"HTTP/1.1 400 Bad Request\r\n" \
-	"Server: SLEdge\r\n"           \
-	"Connection: close\r\n"
-#define HTTP_RESPONSE_400_BAD_REQUEST_LENGTH 61
+	"Server: SLEdge\r\n"
+#define HTTP_RESPONSE_400_BAD_REQUEST_LENGTH 42
 
 #define HTTP_RESPONSE_404_NOT_FOUND  \
 	"HTTP/1.1 404 Not Found\r\n" \
-	"Server: SLEdge\r\n"         \
-	"Connection: close\r\n"
-#define HTTP_RESPONSE_404_NOT_FOUND_LENGTH 59
+	"Server: SLEdge\r\n"
+#define HTTP_RESPONSE_404_NOT_FOUND_LENGTH 40
 
 #define HTTP_RESPONSE_413_PAYLOAD_TOO_LARGE  \
 	"HTTP/1.1 413 Payload Too Large\r\n" \
-	"Server: SLEdge\r\n"                 \
-	"Connection: close\r\n"
-#define HTTP_RESPONSE_413_PAYLOAD_TOO_LARGE_LENGTH 67
+	"Server: SLEdge\r\n"
+#define HTTP_RESPONSE_413_PAYLOAD_TOO_LARGE_LENGTH 48
 
 #define HTTP_RESPONSE_429_TOO_MANY_REQUESTS  \
 	"HTTP/1.1 429 Too Many Requests\r\n" \
-	"Server: SLEdge\r\n"                 \
-	"Connection: close\r\n"
-#define HTTP_RESPONSE_429_TOO_MANY_REQUESTS_LENGTH 67
+	"Server: SLEdge\r\n"
+#define HTTP_RESPONSE_429_TOO_MANY_REQUESTS_LENGTH 48
 
 #define HTTP_RESPONSE_500_INTERNAL_SERVER_ERROR  \
 	"HTTP/1.1 500 Internal Server Error\r\n" \
-	"Server: SLEdge\r\n"                     \
-	"Connection: close\r\n"
-#define HTTP_RESPONSE_500_INTERNAL_SERVER_ERROR_LENGTH 71
+	"Server: SLEdge\r\n"
+#define HTTP_RESPONSE_500_INTERNAL_SERVER_ERROR_LENGTH 52
 
 #define HTTP_RESPONSE_503_SERVICE_UNAVAILABLE  \
 	"HTTP/1.1 503 Service Unavailable\r\n" \
-	"Server: SLEdge\r\n"                   \
-	"Connection: close\r\n"
-#define HTTP_RESPONSE_503_SERVICE_UNAVAILABLE_LENGTH 69
+	"Server: SLEdge\r\n"
+#define HTTP_RESPONSE_503_SERVICE_UNAVAILABLE_LENGTH 50
 
 static inline const char *
 http_header_build(int status_code)
@@ -87,6 +102,8 @@ static inline size_t
 http_header_len(int status_code)
 {
 	switch (status_code) {
+	case 200:
+		return HTTP_RESPONSE_200_OK_LENGTH;
 	case 400:
 		return HTTP_RESPONSE_400_BAD_REQUEST_LENGTH;
 	case 404:
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "http_request.h"
+
+/*
+ * Incremental HTTP/1.x request parser. The request line and headers are only parsed once the whole head has been
+ * received, so header keys and values, the body, and query params are recorded as slices of the request buffer
+ * rather than copied. Until then, each call only scans the newly received bytes for the blank line that ends the
+ * head. Progress is kept as offsets rather than pointers, so the buffer may move between calls.
+ */
+
+enum http_request_parser_state
+{
+	HTTP_REQUEST_PARSER_HEAD = 0,
+	HTTP_REQUEST_PARSER_BODY,           /* Body with a Content-Length */
+	HTTP_REQUEST_PARSER_CHUNK_SIZE,     /* Waiting for a complete chunk size line */
+	HTTP_REQUEST_PARSER_CHUNK_DATA,     /* Inside the data of a chunk */
+	HTTP_REQUEST_PARSER_CHUNK_DATA_END, /* Waiting for the line break that ends the data of a chunk */
+	HTTP_REQUEST_PARSER_TRAILER,        /* Skipping trailer lines after the last chunk */
+	HTTP_REQUEST_PARSER_DONE
+};
+
+struct http_request_parser {
+	enum http_request_parser_state state;
+	size_t                         head_scanned;    /* Bytes of the head already searched for its end */
+	size_t                         chunk_remaining; /* Bytes left in the current chunk of a chunked body */
+	const char                    *error;           /* Why the request was rejected */
+};
+
+static inline void
+http_request_parser_init(struct http_request_parser *parser)
+{
+	parser->state           = HTTP_REQUEST_PARSER_HEAD;
+	parser->head_scanned    = 0;
+	parser->chunk_remaining = 0;
+	parser->error           = NULL;
+}
+
+ssize_t http_request_parser_execute(struct http_request_parser *parser, struct http_request *http_request,
+                                    char *data, size_t length);
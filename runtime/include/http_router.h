@@ -6,17 +6,83 @@
 #include "route_config.h"
 #include "route_latency.h"
 #include "vec.h"
+#include <stdio.h>
 #include <stdlib.h>
 
 typedef struct route route_t;
 VEC(route_t)
 
-typedef struct vec_route_t http_router_t;
+/*
+ * Routes are indexed by a byte trie built as they are added at tenant_alloc time. Nodes live in a flat vec and
+ * refer to each other by index, and children are kept in a sibling list, so a lookup is a single walk down the
+ * request path. A node that ends a route string records the index of that route.
+ */
+struct http_router_node {
+	char     byte;
+	int32_t  route_idx;    /* Route whose string ends at this node, or -1 */
+	uint32_t first_child;  /* 0 if none. The root is node 0, so it is never a child */
+	uint32_t next_sibling; /* 0 if none */
+};
+
+typedef struct http_router_node http_router_node_t;
+VEC(http_router_node_t)
+
+typedef struct http_router {
+	struct vec_route_t            routes; /* Capacity is fixed at init, so route pointers stay valid */
+	struct vec_http_router_node_t nodes;
+} http_router_t;
 
 static inline void
 http_router_init(http_router_t *router, size_t capacity)
 {
-	vec_route_t_init(router, capacity);
+	vec_route_t_init(&router->routes, capacity);
+
+	int rc = vec_http_router_node_t_init(&router->nodes, 64);
+	if (unlikely(rc < 0)) panic("Failed to allocate http router\n");
+
+	struct http_router_node root = {.byte = '\0', .route_idx = -1, .first_child = 0, .next_sibling = 0};
+	vec_http_router_node_t_push(&router->nodes, root);
+}
+
+/**
+ * @returns index of the child of node labeled byte, or 0 if there is none
+ */
+static inline uint32_t
+http_router_node_find_child(http_router_t *router, uint32_t node, char byte)
+{
+	uint32_t child = router->nodes.buffer[node].first_child;
+	while (child != 0 && router->nodes.buffer[child].byte != byte) child = router->nodes.buffer[child].next_sibling;
+	return child;
+}
+
+/**
+ * Adds a route string to the trie. If two routes have the same string, the first one added keeps it
+ * @returns 0 on success, -1 on allocation failure
+ */
+static inline int
+http_router_index_route(http_router_t *router, const char *route, int32_t route_idx)
+{
+	uint32_t node = 0;
+
+	for (const char *cursor = route; *cursor != '\0'; cursor++) {
+		uint32_t child = http_router_node_find_child(router, node, *cursor);
+		if (child == 0) {
+			struct http_router_node new_node = {.byte         = *cursor,
+			                                    .route_idx    = -1,
+			                                    .first_child  = 0,
+			                                    .next_sibling = router->nodes.buffer[node].first_child};
+
+			/* Pushing may move the node buffer, so nodes are only referred to by index */
+			if (unlikely(vec_http_router_node_t_push(&router->nodes, new_node) < 0)) return -1;
+			child                                  = (uint32_t)(router->nodes.length - 1);
+			router->nodes.buffer[node].first_child = child;
+		}
+		node = child;
+	}
+
+	if (router->nodes.buffer[node].route_idx < 0) router->nodes.buffer[node].route_idx = route_idx;
+
+	return 0;
 }
 
 static inline int
@@ -33,7 +99,19 @@ http_router_add_route(http_router_t *router, struct route_config *config, struct
 	                      .module               = module,
 	                      .relative_deadline_us = config->relative_deadline_us,
 	                      .relative_deadline = (uint64_t)config->relative_deadline_us * runtime_processor_speed_MHz,
-	                      .response_content_type = config->http_resp_content_type};
+	                      .quantum_us            = config->quantum_us,
+	                      .response_content_type = config->http_resp_content_type,
+	                      .stream_request_body   = config->stream_request_body,
+	                      .stream_response       = config->stream_response};
+
+	/* Everything but Content-Length and Connection is the same for every successful response on a route */
+	int prefix_length = snprintf(NULL, 0, HTTP_RESPONSE_200_OK HTTP_RESPONSE_CONTENT_TYPE,
+	                             route.response_content_type);
+	route.response_header_prefix = malloc(prefix_length + 1);
+	if (unlikely(route.response_header_prefix == NULL)) return -1;
+	snprintf(route.response_header_prefix, prefix_length + 1, HTTP_RESPONSE_200_OK HTTP_RESPONSE_CONTENT_TYPE,
+	         route.response_content_type);
+	route.response_header_prefix_length = (size_t)prefix_length;
 
 	route_latency_init(&route.latency);
 	http_route_total_init(&route.metrics);
@@ -59,26 +137,54 @@ http_router_add_route(http_router_t *router, struct route_config *config, struct
 	execution_histogram_initialize(&route.execution_histogram, config->admissions_percentile, expected_execution);
 #endif
 
-	int rc = vec_route_t_push(router, route);
-	if (unlikely(rc == -1)) { return -1; }
+	/* Growing would move routes that sessions already point to */
+	if (unlikely(router->routes.length == router->routes.capacity)) goto err;
+
+	/* Indexed first, so the router never holds a copy of the route whose header prefix was freed. The push cannot
+	 * fail once there is room */
+	int rc = http_router_index_route(router, route.route, (int32_t)router->routes.length);
+	if (unlikely(rc == -1)) goto err;
+
+	rc = vec_route_t_push(&router->routes, route);
+	assert(rc == 0);
+
+	/* Bounds the deadlines of future requests, which tickless workers rely on to stop polling for arrivals */
+	if (route.relative_deadline < runtime_min_relative_deadline)
+		runtime_min_relative_deadline = route.relative_deadline;
 
 	return 0;
+
+err:
+	free(route.response_header_prefix);
+	return -1;
 }
 
+/**
+ * Matches a request path to the route with the longest string that is a prefix of the path. An exact match is
+ * always the longest, and the result does not depend on the order routes were declared in.
+ * @param router
+ * @param path request path without the query string
+ * @returns the matched route or NULL
+ */
 static inline struct route *
-http_router_match_route(http_router_t *router, char *route)
+http_router_match_route(http_router_t *router, char *path)
 {
-	for (int i = 0; i < router->length; i++) {
-		if (strncmp(route, router->buffer[i].route, strlen(router->buffer[i].route)) == 0) {
-			return &router->buffer[i];
-		}
+	struct route *match = NULL;
+	uint32_t      node  = 0;
+
+	for (const char *cursor = path; *cursor != '\0'; cursor++) {
+		node = http_router_node_find_child(router, node, *cursor);
+		if (node == 0) break;
+
+		int32_t route_idx = router->nodes.buffer[node].route_idx;
+		if (route_idx >= 0) match = &router->routes.buffer[route_idx];
 	}
 
-	return NULL;
+	return match;
 }
 
 static inline void
 http_router_foreach(http_router_t *router, void (*cb)(route_t *, void *, void *), void *arg_one, void *arg_two)
 {
-	for (int i = 0; i < router->length; i++) { cb(&router->buffer[i], arg_one, arg_two); }
+	for (int i = 0; i < router->routes.length; i++) { cb(&router->routes.buffer[i], arg_one, arg_two); }
 }
@@ -7,20 +7,41 @@
 #include <stdint.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
-#include "auto_buf.h"
 #include "debuglog.h"
 #include "epoll_tag.h"
-#include "http_parser.h"
-#include "http_parser_settings.h"
 #include "http_request.h"
+#include "http_request_parser.h"
 #include "http_route_total.h"
 #include "http_session_perf_log.h"
 #include "http_total.h"
+#include "lock.h"
+#include "memfd_buffer.h"
+#include "object_cache.h"
+#include "ps_list.h"
 #include "route.h"
+#include "runtime.h"
+#include "slab_buffer.h"
 #include "tcp_session.h"
 #include "tenant.h"
+#include "vec.h"
+
+/* Minimum free space in the request buffer before each recv */
+#define HTTP_SESSION_REQUEST_BUFFER_MIN_FREE BUFSIZ
+
+/* Bound on the iovec entries passed to a single writev */
+#define HTTP_SESSION_IOVEC_MAX 64
+
+/* Freed sessions kept by each thread and in the depot shared by all threads. See object_cache.h */
+#define HTTP_SESSION_CACHE_CAPACITY 32
+#define HTTP_SESSION_DEPOT_CAPACITY 1024
+
+struct sandbox;
+
+/* The parser keeps pointers into the request buffer, so it must stay contiguous */
+VEC(char)
 
 enum http_session_state
 {
@@ -30,52 +51,79 @@ enum http_session_state
 	HTTP_SESSION_RECEIVE_REQUEST_BLOCKED,
 	HTTP_SESSION_RECEIVED_REQUEST,
 	HTTP_SESSION_EXECUTING,
+	HTTP_SESSION_STREAMING_RESPONSE,      /* The sandbox is sending chunks of its output while it runs */
+	HTTP_SESSION_STREAM_RESPONSE_BLOCKED, /* The sandbox sleeps until the listener sees the socket writable */
 	HTTP_SESSION_EXECUTION_COMPLETE,
 	HTTP_SESSION_SENDING_RESPONSE_HEADER,
 	HTTP_SESSION_SEND_RESPONSE_HEADER_BLOCKED,
-	HTTP_SESSION_SENT_RESPONSE_HEADER,
 	HTTP_SESSION_SENDING_RESPONSE_BODY,
 	HTTP_SESSION_SEND_RESPONSE_BODY_BLOCKED,
-	HTTP_SESSION_SENT_RESPONSE_BODY
+	HTTP_SESSION_SENT_RESPONSE_BODY,
+	HTTP_SESSION_KEEP_ALIVE_IDLE /* Response sent on a persistent connection. Waiting for the next request */
 };
 
 struct http_session {
-	enum epoll_tag          tag;
-	enum http_session_state state;
-	struct sockaddr         client_address; /* client requesting connection! */
-	int                     socket;
-	struct http_parser      http_parser;
-	struct http_request     http_request;
-	struct auto_buf         request_buffer;
-	struct auto_buf         response_header;
-	size_t                  response_header_written;
-	struct auto_buf         response_body;
-	size_t                  response_body_written;
-	struct tenant          *tenant; /* Backlink required when read blocks on listener core */
-	struct route           *route;  /* Backlink required to handle http metrics */
-	uint64_t                request_arrival_timestamp;
-	uint64_t                request_downloaded_timestamp;
-	uint64_t                response_takeoff_timestamp;
-	uint64_t                response_sent_timestamp;
-	bool                    did_preprocessing;
-	uint64_t                preprocessing_duration;
-	double                  regression_param; /* Calculated in tenant preprocessing logic if provided */
+	enum epoll_tag             tag;
+	enum http_session_state    state;
+	struct sockaddr            client_address; /* client requesting connection! */
+	int                        socket;
+	struct http_request_parser http_parser;
+	struct http_request        http_request;
+	struct vec_char            request_buffer;
+	struct memfd_buffer        request_body_buffer; /* Large bodies bypass request_buffer. See receive_request */
+	struct slab_buffer         response_header;
+	size_t                     response_header_written;
+	struct slab_buffer         response_body;
+	size_t                     response_body_written;
+	struct tenant             *tenant; /* Backlink required when read blocks on listener core */
+	int                        listener_thread_idx; /* Listener that accepted the session and owns its epoll */
+	struct route              *route;  /* Backlink required to handle http metrics */
+	uint64_t                   request_arrival_timestamp;
+	uint64_t                   request_downloaded_timestamp;
+	uint64_t                   response_takeoff_timestamp;
+	uint64_t                   response_sent_timestamp;
+	bool                       did_preprocessing;
+	uint64_t                   preprocessing_duration;
+	double                     regression_param; /* Calculated in tenant preprocessing logic if provided */
+	bool                       keep_alive;       /* Reuse the connection for another request after responding */
+	uint32_t                   requests_served;  /* Responses sent on this connection */
+	uint64_t                   idle_timestamp;   /* When the session last became idle between requests */
+	struct ps_list             list;             /* Links the session into its listener's idle list */
+
+	/*
+	 * Set when the route streams its request body, so the sandbox was dispatched once the headers arrived and
+	 * runs while the listener receives the rest of the body. The listener publishes its progress under
+	 * request_body_lock, and wakes the sandbox if it went to sleep waiting for more of the body.
+	 */
+	bool                       request_body_streaming;
+	lock_t                     request_body_lock;
+	int                        request_body_available;     /* Bytes of the body the sandbox may read */
+	bool                       request_body_complete;      /* No more of the body will arrive */
+	struct sandbox            *request_body_waiter;        /* Asleep until request_body_available changes */
+	int                        request_body_waiter_worker;
+
+	/*
+	 * Set once a sandbox of a route that streams its response sends the header. Its output is then sent in chunks
+	 * whenever runtime_response_chunk_size bytes are buffered, and the sandbox sleeps if the socket would block.
+	 */
+	bool                       response_streaming;
+	struct sandbox            *response_waiter; /* Asleep until the listener sees the socket writable */
+	int                        response_waiter_worker;
 };
 
+INIT_OBJECT_CACHE(http_session, HTTP_SESSION_CACHE_CAPACITY, HTTP_SESSION_DEPOT_CAPACITY)
+
 extern void http_session_perf_log_print_entry(struct http_session *http_session);
 
 /**
  * Initalize state associated with an http parser
- * Because the http_parser structure uses pointers to the request buffer, if realloc moves the request
- * buffer, this should be called to clear stale state to force parsing to restart
+ * The http_request holds pointers into the request buffer. See http_session_reserve_request_buffer
  */
 static inline void
 http_session_parser_init(struct http_session *session)
 {
 	memset(&session->http_request, 0, sizeof(struct http_request));
-	http_parser_init(&session->http_parser, HTTP_REQUEST);
-	/* Set the session as the data the http-parser has access to */
-	session->http_parser.data = &session->http_request;
+	http_request_parser_init(&session->http_parser);
 }
 
 /**
@@ -84,7 +132,7 @@ http_session_parser_init(struct http_session *session)
  */
 static inline int
 http_session_init(struct http_session *session, int socket_descriptor, const struct sockaddr *socket_address,
-                  struct tenant *tenant, uint64_t request_arrival_timestamp)
+                  struct tenant *tenant, int listener_idx, uint64_t request_arrival_timestamp)
 {
 	assert(session != NULL);
 	assert(session->state == HTTP_SESSION_UNINITIALIZED);
@@ -93,18 +141,25 @@ http_session_init(struct http_session *session, int socket_descriptor, const str
 
 	session->tag                       = EPOLL_TAG_HTTP_SESSION_CLIENT_SOCKET;
 	session->tenant                    = tenant;
+	session->listener_thread_idx       = listener_idx;
 	session->route                     = NULL;
 	session->socket                    = socket_descriptor;
 	session->request_arrival_timestamp = request_arrival_timestamp;
 	memcpy(&session->client_address, socket_address, sizeof(struct sockaddr));
+	ps_list_init_d(session);
 
 	http_session_parser_init(session);
 
-	int rc = auto_buf_init(&session->request_buffer);
+	int rc = vec_char_init(&session->request_buffer, HTTP_SESSION_REQUEST_BUFFER_MIN_FREE);
 	if (rc < 0) return -1;
 
-	/* Defer initializing response_body until we've matched a route */
-	auto_buf_init(&session->response_header);
+	/* The body buffer is only allocated once the headers announce a large enough body */
+	session->request_body_buffer.fd = -1;
+	lock_init(&session->request_body_lock);
+
+	/* Slabs are only taken from the pool once something is written */
+	slab_buffer_init(&session->response_header);
+	slab_buffer_init(&session->response_body);
 
 	session->state = HTTP_SESSION_INITIALIZED;
 
@@ -115,32 +170,34 @@ static inline int
 http_session_init_response_body(struct http_session *session)
 {
 	assert(session != NULL);
-	assert(session->response_body.data == NULL);
+	assert(session->response_body.head == NULL);
 	assert(session->response_body.size == 0);
 	assert(session->response_body_written == 0);
 
-	int rc = auto_buf_init(&session->response_body);
-	if (rc < 0) {
-		auto_buf_deinit(&session->request_buffer);
-		return -1;
-	}
+	slab_buffer_init(&session->response_body);
 
 	return 0;
 }
 
 static inline struct http_session *
 http_session_alloc(int socket_descriptor, const struct sockaddr *socket_address, struct tenant *tenant,
-                   uint64_t request_arrival_timestamp)
+                   int listener_idx, uint64_t request_arrival_timestamp)
 {
 	assert(socket_descriptor >= 0);
 	assert(socket_address != NULL);
 
-	struct http_session *session = calloc(1, sizeof(struct http_session));
-	if (session == NULL) return NULL;
+	struct http_session *session = http_session_cache_take();
+	if (session != NULL) {
+		memset(session, 0, sizeof(struct http_session));
+	} else {
+		session = calloc(1, sizeof(struct http_session));
+		if (session == NULL) return NULL;
+	}
 
-	int rc = http_session_init(session, socket_descriptor, socket_address, tenant, request_arrival_timestamp);
+	int rc = http_session_init(session, socket_descriptor, socket_address, tenant, listener_idx,
+	                           request_arrival_timestamp);
 	if (rc != 0) {
-		free(session);
+		if (!http_session_cache_give(session)) free(session);
 		return NULL;
 	}
 
@@ -156,9 +213,10 @@ http_session_deinit(struct http_session *session)
 {
 	assert(session);
 
-	auto_buf_deinit(&session->request_buffer);
-	auto_buf_deinit(&session->response_header);
-	auto_buf_deinit(&session->response_body);
+	vec_char_deinit(&session->request_buffer);
+	memfd_buffer_deinit(&session->request_body_buffer);
+	slab_buffer_deinit(&session->response_header);
+	slab_buffer_deinit(&session->response_body);
 }
 
 static inline void
@@ -167,7 +225,68 @@ http_session_free(struct http_session *session)
 	assert(session);
 
 	http_session_deinit(session);
-	free(session);
+	if (!http_session_cache_give(session)) free(session);
+}
+
+/**
+ * Resets a session after a response was sent on a persistent connection, so the next request on the same socket
+ * can be received. The request buffer keeps its allocation and the response slabs go back to the thread's pool.
+ * @param session
+ */
+static inline void
+http_session_reset(struct http_session *session)
+{
+	assert(session != NULL);
+	assert(session->state == HTTP_SESSION_SENT_RESPONSE_BODY);
+	assert(session->keep_alive);
+
+	http_session_parser_init(session);
+
+	session->request_buffer.length = 0;
+	memfd_buffer_deinit(&session->request_body_buffer);
+	slab_buffer_deinit(&session->response_header);
+	slab_buffer_deinit(&session->response_body);
+
+	session->route                        = NULL;
+	session->response_header_written      = 0;
+	session->response_body_written        = 0;
+	session->request_arrival_timestamp    = 0;
+	session->request_downloaded_timestamp = 0;
+	session->response_takeoff_timestamp   = 0;
+	session->response_sent_timestamp      = 0;
+	session->did_preprocessing            = false;
+	session->preprocessing_duration       = 0;
+	session->regression_param             = 0;
+	session->keep_alive                   = false;
+	session->request_body_streaming       = false;
+	session->request_body_available       = 0;
+	session->request_body_complete        = false;
+	session->request_body_waiter          = NULL;
+	session->response_streaming           = false;
+	session->response_waiter              = NULL;
+	session->state                        = HTTP_SESSION_INITIALIZED;
+}
+
+/**
+ * Decides if the connection can be reused once the response to the current request has been sent.
+ * Must be called after the request has been fully received.
+ * @param session
+ * @returns true if the client asked for a persistent connection and the runtime limits allow one
+ */
+static inline bool
+http_session_should_keep_alive(struct http_session *session)
+{
+	assert(session->state == HTTP_SESSION_RECEIVED_REQUEST);
+
+	if (runtime_http_keep_alive_timeout_ms == 0) return false;
+	if (runtime_http_keep_alive_max_requests != 0
+	    && session->requests_served + 1 >= runtime_http_keep_alive_max_requests)
+		return false;
+
+	/* Pipelined requests are not supported, so close connections that sent bytes past the current request */
+	if (session->http_request.length_parsed != session->request_buffer.length) return false;
+
+	return session->http_request.keep_alive;
 }
 
 /**
@@ -185,28 +304,31 @@ http_session_set_response_header(struct http_session *session, int status_code)
 	/* We might not have actually matched a route */
 	if (likely(session->route != NULL)) { http_route_total_increment(&session->route->metrics, status_code); }
 
-	int rc = fputs(http_header_build(status_code), session->response_header.handle);
-	assert(rc != EOF);
+	struct slab_buffer *header = &session->response_header;
+	int                 rc;
 
 	if (status_code == 200) {
-		/* Make sure the response_body is flushed */
-		int rc = auto_buf_flush(&session->response_body);
-		if (unlikely(rc != 0)) { panic("response_body auto_buf failed to flush: %s\n", strerror(errno)); };
-
-		/* Technically fprintf can truncate, but I assume this won't happen with a memstream */
-		rc = fprintf(session->response_header.handle, HTTP_RESPONSE_CONTENT_TYPE,
-		             session->route->response_content_type);
-		assert(rc > 0);
-		rc = fprintf(session->response_header.handle, HTTP_RESPONSE_CONTENT_LENGTH,
-		             session->response_body.size);
-		assert(rc > 0);
+		/* The status, Server and Content-Type lines are rendered once per route */
+		rc = slab_buffer_write(header, session->route->response_header_prefix,
+		                       session->route->response_header_prefix_length);
+		if (session->response_streaming) {
+			rc |= slab_buffer_write(header, HTTP_RESPONSE_CHUNKED, strlen(HTTP_RESPONSE_CHUNKED));
+		} else {
+			rc |= slab_buffer_printf(header, HTTP_RESPONSE_CONTENT_LENGTH, session->response_body.size);
+		}
+	} else {
+		rc = slab_buffer_write(header, http_header_build(status_code), http_header_len(status_code));
 	}
 
-	rc = fputs(HTTP_RESPONSE_TERMINATOR, session->response_header.handle);
-	assert(rc != EOF);
+	if (session->keep_alive) {
+		rc |= slab_buffer_write(header, HTTP_RESPONSE_CONNECTION_KEEP_ALIVE,
+		                        strlen(HTTP_RESPONSE_CONNECTION_KEEP_ALIVE));
+	} else {
+		rc |= slab_buffer_write(header, HTTP_RESPONSE_CONNECTION_CLOSE, strlen(HTTP_RESPONSE_CONNECTION_CLOSE));
+	}
 
-	rc = auto_buf_flush(&session->response_header);
-	if (unlikely(rc != 0)) { panic("response_header auto_buf failed to flush: %s\n", strerror(errno)); };
+	rc |= slab_buffer_write(header, HTTP_RESPONSE_TERMINATOR, HTTP_RESPONSE_TERMINATOR_LENGTH);
+	if (unlikely(rc != 0)) panic("failed to build response header\n");
 
 	session->response_takeoff_timestamp = __getcycles();
 }
@@ -220,64 +342,44 @@ http_session_close(struct http_session *session)
 }
 
 /**
- * Writes an HTTP header to the client
- * @param client_socket - the client
+ * Writes the response header and body to the client, gathering both into each writev so a small response leaves
+ * in a single syscall. response_header_written and response_body_written form the cursor, so a send interrupted by
+ * EAGAIN resumes where it left off. The state records which of the two buffers the cursor is in.
+ * @param session
  * @param on_eagain - cb to execute when client socket returns EAGAIN. If NULL, error out
- * @returns 0 on success, -errno on error
+ * @returns 0 on success, -errno on error, -EAGAIN on block
  */
 static inline int
-http_session_send_response_header(struct http_session *session, void_star_cb on_eagain)
+http_session_send_response_buffers(struct http_session *session, void_star_cb on_eagain)
 {
 	assert(session != NULL);
-	assert(session->state == HTTP_SESSION_EXECUTION_COMPLETE
-	       || session->state == HTTP_SESSION_SEND_RESPONSE_HEADER_BLOCKED);
-	session->state = HTTP_SESSION_SENDING_RESPONSE_HEADER;
-
-	while (session->response_header.size > session->response_header_written) {
-		ssize_t sent =
-		  tcp_session_send(session->socket,
-		                   (const char *)&session->response_header.data[session->response_header_written],
-		                   session->response_header.size - session->response_header_written, on_eagain,
-		                   session);
-		if (sent < 0) {
-			return (int)sent;
-		} else {
-			session->response_header_written += (size_t)sent;
-		}
-	}
+	assert(session->state == HTTP_SESSION_EXECUTION_COMPLETE || session->state == HTTP_SESSION_STREAMING_RESPONSE
+	       || session->state == HTTP_SESSION_SEND_RESPONSE_HEADER_BLOCKED
+	       || session->state == HTTP_SESSION_SEND_RESPONSE_BODY_BLOCKED);
 
-	session->state = HTTP_SESSION_SENT_RESPONSE_HEADER;
+	struct slab_buffer *header = &session->response_header;
+	struct slab_buffer *body   = &session->response_body;
 
-	return 0;
-}
+	while (session->response_header_written < header->size || session->response_body_written < body->size) {
+		session->state = session->response_header_written < header->size ? HTTP_SESSION_SENDING_RESPONSE_HEADER
+		                                                                  : HTTP_SESSION_SENDING_RESPONSE_BODY;
 
-/**
- * Writes an HTTP body to the client
- * @param client_socket - the client
- * @param on_eagain - cb to execute when client socket returns EAGAIN. If NULL, error out
- * @returns 0 on success, -errno on error
- */
-static inline int
-http_session_send_response_body(struct http_session *session, void_star_cb on_eagain)
-{
-	assert(session != NULL);
+		struct iovec iov[HTTP_SESSION_IOVEC_MAX];
+		int          iovcnt = slab_buffer_export_iovec(header, session->response_header_written, iov,
+		                                               HTTP_SESSION_IOVEC_MAX);
+		iovcnt += slab_buffer_export_iovec(body, session->response_body_written, &iov[iovcnt],
+		                                   HTTP_SESSION_IOVEC_MAX - iovcnt);
 
-	assert(session->state == HTTP_SESSION_SENT_RESPONSE_HEADER
-	       || session->state == HTTP_SESSION_SEND_RESPONSE_BODY_BLOCKED);
-	session->state = HTTP_SESSION_SENDING_RESPONSE_BODY;
-
-	/* Assumption: Already flushed in order to write content-length to header */
-	// TODO: Test if body is empty
-
-	while (session->response_body_written < session->response_body.size) {
-		ssize_t sent =
-		  tcp_session_send(session->socket,
-		                   (const char *)&session->response_body.data[session->response_body_written],
-		                   session->response_body.size - session->response_body_written, on_eagain, session);
-		if (sent < 0) {
-			return (int)sent;
+		ssize_t sent = tcp_session_sendv(session->socket, iov, iovcnt, on_eagain, session);
+		if (sent < 0) return (int)sent;
+
+		/* Advance the cursor through the header first, then the body */
+		size_t header_remaining = header->size - session->response_header_written;
+		if ((size_t)sent <= header_remaining) {
+			session->response_header_written += (size_t)sent;
 		} else {
-			session->response_body_written += (size_t)sent;
+			session->response_header_written = header->size;
+			session->response_body_written += (size_t)sent - header_remaining;
 		}
 	}
 
@@ -287,35 +389,94 @@ http_session_send_response_body(struct http_session *session, void_star_cb on_ea
 
 typedef void (*http_session_cb)(struct http_session *);
 
+/**
+ * Runs the request parser over a run of received bytes
+ * @param session
+ * @param data - bytes to parse
+ * @param length - number of bytes to parse
+ * @returns number of bytes parsed, -1 on error
+ */
+static inline ssize_t
+http_session_execute_parser(struct http_session *session, char *data, size_t length)
+{
+	ssize_t bytes_parsed = http_request_parser_execute(&session->http_parser, &session->http_request, data, length);
+	if (bytes_parsed < 0) {
+		debuglog("Error: %s, Length Read %zu\n", session->http_parser.error, length);
+		debuglog("Error parsing socket %d\n", session->socket);
+		return -1;
+	}
+
+	return (ssize_t)bytes_parsed;
+}
+
 static inline ssize_t
 http_session_parse(struct http_session *session, ssize_t bytes_received)
 {
 	assert(session != 0);
 	assert(bytes_received > 0);
 
-	const http_parser_settings *settings = http_parser_settings_get();
+	ssize_t bytes_parsed =
+	  http_session_execute_parser(session,
+	                              &session->request_buffer.buffer[session->http_request.length_parsed],
+	                              session->request_buffer.length - (size_t)session->http_request.length_parsed);
+	if (bytes_parsed < 0) return -1;
 
-#ifdef LOG_HTTP_PARSER
-	debuglog("http_parser_execute(%p, %p, %p, %zu\n)", &session->http_parser, settings,
-	         &session->request_buffer.buffer[session->request_buffer.length], bytes_received);
-#endif
-	size_t bytes_parsed =
-	  http_parser_execute(&session->http_parser, settings,
-	                      (const char *)&session->request_buffer.data[session->http_request.length_parsed],
-	                      (size_t)session->request_buffer.size - session->http_request.length_parsed);
-
-	if (session->http_parser.http_errno != HPE_OK) {
-		debuglog("Error: %s, Description: %s\n",
-		         http_errno_name((enum http_errno)session->http_parser.http_errno),
-		         http_errno_description((enum http_errno)session->http_parser.http_errno));
-		debuglog("Length Parsed %zu, Length Read %zu\n", bytes_parsed, (size_t)bytes_received);
-		debuglog("Error parsing socket %d\n", session->socket);
+	session->http_request.length_parsed += bytes_parsed;
+
+	return bytes_parsed;
+}
+
+/**
+ * Allocates the memfd_buffer for a body of known length and moves the part of it received so far. The body then
+ * stays at the same address until the session is reset, unlike bodies in request_buffer.
+ * @param session
+ * @returns 0 on success, -1 on error
+ */
+static inline int
+http_session_move_request_body_to_buffer(struct http_session *session)
+{
+	struct http_request *http_request = &session->http_request;
+
+	assert(http_request->body_length > 0);
+	assert(session->request_body_buffer.data == NULL);
+
+	int rc = memfd_buffer_init(&session->request_body_buffer, (size_t)http_request->body_length);
+	if (unlikely(rc < 0)) {
+		debuglog("Failed to allocate request body buffer: %s\n", strerror(errno));
 		return -1;
 	}
 
-	session->http_request.length_parsed += bytes_parsed;
+	/* Copy the part of the body that arrived along with the headers */
+	if (http_request->body_length_read > 0) {
+		assert(http_request->body != NULL);
+		memcpy(session->request_body_buffer.data, http_request->body, http_request->body_length_read);
+	}
 
-	return (ssize_t)bytes_parsed;
+	http_request->body = (char *)session->request_body_buffer.data;
+	return 0;
+}
+
+/**
+ * Moves the body of a request into a memfd_buffer once the headers are parsed, if the body is at least
+ * runtime_request_body_memfd_threshold bytes. The rest of the body is then received straight into this buffer,
+ * and the request_body hostcall can map it into linear memory instead of copying it.
+ * @param session
+ * @returns 0 on success, -1 on error
+ */
+static inline int
+http_session_init_request_body_buffer(struct http_session *session)
+{
+	struct http_request *http_request = &session->http_request;
+
+	assert(http_request->header_end && !http_request->message_end);
+	assert(session->request_body_buffer.data == NULL);
+
+	/* body_length is negative if the length is not known up front, as with chunked transfer encoding */
+	if (runtime_request_body_memfd_threshold == 0 || http_request->body_length <= 0
+	    || http_request->body_length < runtime_request_body_memfd_threshold)
+		return 0;
+
+	return http_session_move_request_body_to_buffer(session);
 }
 
 static inline void
@@ -344,27 +505,87 @@ http_session_log_malformed_request(struct http_session *session)
 #endif
 }
 
+/**
+ * Makes room for at least HTTP_SESSION_REQUEST_BUFFER_MIN_FREE bytes at the end of the request buffer. If realloc
+ * moves the buffer, the header and body pointers the parser already handed out are moved along with it.
+ * @param session
+ * @returns 0 on success, -1 on allocation failure
+ */
+static inline int
+http_session_reserve_request_buffer(struct http_session *session)
+{
+	struct vec_char *buffer = &session->request_buffer;
+
+	if (buffer->capacity - buffer->length >= HTTP_SESSION_REQUEST_BUFFER_MIN_FREE) return 0;
+
+	const uintptr_t old_buffer   = (uintptr_t)buffer->buffer;
+	const uintptr_t old_end      = old_buffer + buffer->length;
+	size_t          new_capacity = buffer->capacity * 2;
+	if (new_capacity < buffer->length + HTTP_SESSION_REQUEST_BUFFER_MIN_FREE)
+		new_capacity = buffer->length + HTTP_SESSION_REQUEST_BUFFER_MIN_FREE;
+
+	if (vec_char_resize(buffer, new_capacity) < 0) return -1;
+	if ((uintptr_t)buffer->buffer == old_buffer) return 0;
+
+	struct http_request *http_request = &session->http_request;
+	const ptrdiff_t      delta        = (ptrdiff_t)((uintptr_t)buffer->buffer - old_buffer);
+
+#define HTTP_SESSION_REBASE(pointer)                                                               \
+	if ((pointer) != NULL && (uintptr_t)(pointer) >= old_buffer && (uintptr_t)(pointer) <= old_end) \
+		(pointer) += delta;
+
+	for (int i = 0; i < http_request->header_count; i++) {
+		HTTP_SESSION_REBASE(http_request->headers[i].key);
+		HTTP_SESSION_REBASE(http_request->headers[i].value);
+	}
+	for (int i = 0; i < http_request->query_params_count; i++) {
+		HTTP_SESSION_REBASE(http_request->query_params[i].value);
+	}
+	HTTP_SESSION_REBASE(http_request->body);
+
+#undef HTTP_SESSION_REBASE
+
+	return 0;
+}
+
 /**
  * Receive and Parse the Request for the current sandbox
- * @return 0 if message parsing complete, -1 on error, -EAGAIN if would block
+ * @return 0 if message parsing complete, -1 on error, -EAGAIN if would block, -ENOTCONN if the client closed a
+ * persistent connection between requests
  */
 static inline int
 http_session_receive_request(struct http_session *session, void_star_cb on_eagain)
 {
 	assert(session != NULL);
-	assert(session->request_buffer.handle != NULL);
+	assert(session->request_buffer.buffer != NULL);
 	assert(session->state == HTTP_SESSION_INITIALIZED || session->state == HTTP_SESSION_RECEIVE_REQUEST_BLOCKED);
 
 	session->state = HTTP_SESSION_RECEIVING_REQUEST;
 
 	struct http_request *http_request = &session->http_request;
 	int                  rc           = 0;
-	char                 temp[BUFSIZ];
 
 	while (!http_request->message_end) {
-		ssize_t bytes_received = tcp_session_recv(session->socket, temp, BUFSIZ, on_eagain, session);
+		/* Once the body has its own buffer, the rest of it is received straight into that buffer */
+		const bool into_body_buffer = session->request_body_buffer.data != NULL;
+		char      *destination;
+		size_t     capacity;
+		if (into_body_buffer) {
+			destination = &http_request->body[http_request->body_length_read];
+			capacity    = (size_t)(http_request->body_length - http_request->body_length_read);
+		} else {
+			if (unlikely(http_session_reserve_request_buffer(session) < 0)) goto err;
+			destination = &session->request_buffer.buffer[session->request_buffer.length];
+			capacity    = session->request_buffer.capacity - session->request_buffer.length;
+		}
+
+		ssize_t bytes_received = tcp_session_recv(session->socket, destination, capacity, on_eagain, session);
 		if (unlikely(bytes_received == -EAGAIN))
 			goto err_eagain;
+		/* A client closing a persistent connection before sending another request is not an error */
+		else if (unlikely(bytes_received <= 0 && session->requests_served > 0
+		                  && session->request_buffer.length == 0))
+			goto err_notconn;
 		else if (unlikely(bytes_received < 0))
 			goto err;
 		/* If we received an EOF before we were able to parse a complete HTTP message, request is malformed */
@@ -373,22 +594,19 @@ http_session_receive_request(struct http_session *session, void_star_cb on_eagai
 
 		assert(bytes_received > 0);
 
-		const char   *old_buffer    = session->request_buffer.data;
-		const ssize_t header_length = session->request_buffer.size - http_request->body_length_read;
-		assert(!http_request->header_end || header_length > 0);
+		if (into_body_buffer) {
+			if (http_session_execute_parser(session, destination, (size_t)bytes_received) == -1) goto err;
+			continue;
+		}
 
-		/* Write temp buffer to memstream */
-		fwrite(temp, 1, bytes_received, session->request_buffer.handle);
+		session->request_buffer.length += (size_t)bytes_received;
 
-		/* fflush memstream managed buffer */
-		fflush(session->request_buffer.handle);
+		if (http_session_parse(session, bytes_received) == -1) goto err;
 
-		/* Update parser structure if buffer moved */
-		if (old_buffer != session->request_buffer.data) {
-			http_request->body = header_length ? session->request_buffer.data + header_length : NULL;
+		if (http_request->header_end && !http_request->message_end
+		    && session->request_body_buffer.data == NULL) {
+			if (http_session_init_request_body_buffer(session) < 0) goto err;
 		}
-
-		if (http_session_parse(session, bytes_received) == -1) goto err;
 	}
 
 	assert(http_request->message_end == true);
@@ -402,6 +620,9 @@ done:
 err_eagain:
 	rc = -EAGAIN;
 	goto done;
+err_notconn:
+	rc = -ENOTCONN;
+	goto done;
 err:
 	http_session_log_malformed_request(session);
 	rc = -1;
@@ -416,28 +637,69 @@ static inline int
 http_session_write_response(struct http_session *session, const uint8_t *source, size_t n)
 {
 	assert(session);
-	assert(session->response_body.handle != NULL);
 	assert(source);
 
-	return fwrite(source, 1, n, session->response_body.handle);
+	if (unlikely(slab_buffer_write(&session->response_body, source, n) < 0)) return -1;
+
+	return (int)n;
 }
 
-static inline void
-http_session_send_response(struct http_session *session, void_star_cb on_eagain)
+/**
+ * Frames the buffered output of a streaming response as a chunk. The chunk size line goes after anything already in
+ * response_header, so a single send_response_buffers writes the header, the size line and the data in order.
+ * @param session
+ * @param last - also append the zero-length chunk that ends the response
+ * @returns 0 on success, -1 on allocation failure
+ */
+static inline int
+http_session_frame_response_chunk(struct http_session *session, bool last)
 {
-	assert(session->state == HTTP_SESSION_EXECUTION_COMPLETE);
+	assert(session->response_streaming);
+	assert(session->response_body_written == 0);
 
-	int rc = http_session_send_response_header(session, on_eagain);
-	/* session blocked and registered to epoll so continue to next handle */
-	if (unlikely(rc == -EAGAIN)) {
-		goto DONE;
-	} else if (unlikely(rc < 0)) {
-		goto CLOSE;
+	int rc = 0;
+
+	if (session->response_body.size > 0) {
+		rc |= slab_buffer_printf(&session->response_header, HTTP_RESPONSE_CHUNK_SIZE,
+		                         session->response_body.size);
+		rc |= slab_buffer_write(&session->response_body, HTTP_RESPONSE_TERMINATOR,
+		                        HTTP_RESPONSE_TERMINATOR_LENGTH);
 	}
 
-	assert(session->state == HTTP_SESSION_SENT_RESPONSE_HEADER);
+	if (last) {
+		rc |= slab_buffer_write(&session->response_body, HTTP_RESPONSE_LAST_CHUNK,
+		                        strlen(HTTP_RESPONSE_LAST_CHUNK));
+	}
+
+	return rc == 0 ? 0 : -1;
+}
+
+/**
+ * Returns the slabs of a chunk that was sent, so a streaming response only ever holds one chunk in memory
+ * @param session
+ */
+static inline void
+http_session_release_response_chunk(struct http_session *session)
+{
+	slab_buffer_deinit(&session->response_header);
+	slab_buffer_deinit(&session->response_body);
+	session->response_header_written = 0;
+	session->response_body_written   = 0;
+}
 
-	rc = http_session_send_response_body(session, on_eagain);
+/**
+ * Sends the response to the client. Once sent, the session is either closed and freed or, on a persistent
+ * connection, reset and handed to on_keep_alive to wait for the next request
+ * @param session
+ * @param on_eagain - cb to execute when client socket returns EAGAIN
+ * @param on_keep_alive - cb to execute with the reset session when the connection is kept open
+ */
+static inline void
+http_session_send_response(struct http_session *session, void_star_cb on_eagain, void_star_cb on_keep_alive)
+{
+	assert(session->state == HTTP_SESSION_EXECUTION_COMPLETE);
+
+	int rc = http_session_send_response_buffers(session, on_eagain);
 	/* session blocked and registered to epoll so continue to next handle */
 	if (unlikely(rc == -EAGAIN)) {
 		goto DONE;
@@ -450,6 +712,13 @@ http_session_send_response(struct http_session *session, void_star_cb on_eagain)
 	/* Terminal State Logging for Http Session */
 	session->response_sent_timestamp = __getcycles();
 	http_session_perf_log_print_entry(session);
+	session->requests_served++;
+
+	if (session->keep_alive) {
+		http_session_reset(session);
+		on_keep_alive(session);
+		goto DONE;
+	}
 
 CLOSE:
 	http_session_close(session);
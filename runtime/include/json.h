@@ -171,3 +171,21 @@ parse_uint64_t(jsmntok_t tok, const char *json_buf, const char *key, uint64_t *r
 	*ret = temp;
 	return 0;
 }
+
+static inline int
+parse_bool(jsmntok_t tok, const char *json_buf, const char *key, bool *ret)
+{
+	const char *value  = &json_buf[tok.start];
+	const int   length = tok.end - tok.start;
+
+	if (length == 4 && strncmp(value, "true", 4) == 0) {
+		*ret = true;
+	} else if (length == 5 && strncmp(value, "false", 5) == 0) {
+		*ret = false;
+	} else {
+		fprintf(stderr, "Unable to parse bool for key %s\n", key);
+		return -1;
+	}
+
+	return 0;
+}
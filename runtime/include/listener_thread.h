@@ -2,16 +2,39 @@
 
 #include <stdbool.h>
 #include <stdnoreturn.h>
+#include <threads.h>
 
 #include "http_session.h"
+#include "lock.h"
 #include "module.h"
+#include "ps_list.h"
+#include "types.h"
 
+/* Listener threads are pinned to consecutive cores starting here. Workers are pinned to the cores that follow */
 #define LISTENER_THREAD_CORE_ID 1
 
-extern pthread_t listener_thread_id;
+/*
+ * Each listener thread owns a private epoll instance and a private SO_REUSEPORT socket for every tenant, so the
+ * kernel load balances incoming connections across listeners and no state is shared between them. A session stays
+ * on the listener that accepted it for its whole lifetime.
+ *
+ * Persistent connections waiting for their next request are kept on idle_sessions in the order they became idle,
+ * so the listener can close the ones past the keep-alive timeout. Workers add sessions to this list after sending a
+ * response, so it is protected by a lock.
+ */
+struct listener_thread {
+	pthread_t           id;
+	int                 idx;
+	int                 epoll_file_descriptor;
+	lock_t              idle_sessions_lock;
+	struct ps_list_head idle_sessions;
+} CACHE_PAD_ALIGNED;
+
+extern struct listener_thread *listener_threads;
+extern thread_local int        listener_thread_idx;
 
 void           listener_thread_initialize(void);
-noreturn void *listener_thread_main(void *dummy);
+noreturn void *listener_thread_main(void *argument);
 void           listener_thread_register_http_session(struct http_session *http);
 
 /**
@@ -21,5 +44,5 @@ void           listener_thread_register_http_session(struct http_session *http);
 static inline bool
 listener_thread_is_running()
 {
-	return pthread_self() == listener_thread_id;
+	return listener_thread_idx >= 0;
 }
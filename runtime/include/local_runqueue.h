@@ -1,7 +1,9 @@
 #pragma once
 
+#include <stdatomic.h>
 #include <stdbool.h>
 
+#include "lock.h"
 #include "sandbox_types.h"
 
 /* Returns pointer back if successful, null otherwise */
@@ -9,16 +11,54 @@ typedef void (*local_runqueue_add_fn_t)(struct sandbox *);
 typedef bool (*local_runqueue_is_empty_fn_t)(void);
 typedef void (*local_runqueue_delete_fn_t)(struct sandbox *sandbox);
 typedef struct sandbox *(*local_runqueue_get_next_fn_t)();
+/* Removes the highest priority stealable sandbox from another worker's runqueue. Called with the slot locked */
+typedef struct sandbox *(*local_runqueue_steal_fn_t)(void *runqueue);
 
 struct local_runqueue_config {
 	local_runqueue_add_fn_t      add_fn;
 	local_runqueue_is_empty_fn_t is_empty_fn;
 	local_runqueue_delete_fn_t   delete_fn;
 	local_runqueue_get_next_fn_t get_next_fn;
+	local_runqueue_steal_fn_t    steal_fn; /* NULL if the variant does not support stealing */
 };
 
+/*
+ * Idle workers steal from the runqueues of other workers. Each worker publishes its runqueue in a slot, along with
+ * a lock that the owner takes around every runqueue operation while stealing is enabled, and a count of the
+ * sandboxes on it that thieves read to pick a victim.
+ *
+ * Only runnable sandboxes that have not started are stolen, as nothing ties them to a worker yet. A sandbox that has
+ * run stays on its worker, as compiled module code may keep the address of the thread-local module instance in a
+ * register across a preemption point. Thieves never take the head of a runqueue, which is the sandbox the owner runs
+ * next, so a sandbox the owner has picked cannot be stolen out from under it.
+ */
+struct local_runqueue_slot {
+	lock_t           lock;
+	void            *runqueue;
+	_Atomic uint32_t length;
+} CACHE_PAD_ALIGNED;
+
+/* Array of runtime_worker_threads_count slots, indexed by worker_thread_idx */
+extern struct local_runqueue_slot *local_runqueue_slots;
+
 void            local_runqueue_add(struct sandbox *);
 void            local_runqueue_delete(struct sandbox *);
 bool            local_runqueue_is_empty();
 struct sandbox *local_runqueue_get_next();
 void            local_runqueue_initialize(struct local_runqueue_config *config);
+void            local_runqueue_slots_initialize(void);
+void            local_runqueue_publish(void *runqueue);
+void            local_runqueue_lock(lock_node_t *node);
+void            local_runqueue_unlock(lock_node_t *node);
+struct sandbox *local_runqueue_steal(void);
+
+/**
+ * @param sandbox a sandbox on another worker's runqueue, but not at its head
+ * @returns true if the sandbox is runnable and has never run, so it may move to another worker
+ */
+static inline bool
+local_runqueue_is_stealable(struct sandbox *sandbox)
+{
+	/* A sandbox adds to its runnable time when it first leaves SANDBOX_RUNNABLE */
+	return sandbox->state == SANDBOX_RUNNABLE && sandbox->duration_of_state[SANDBOX_RUNNABLE] == 0;
+}
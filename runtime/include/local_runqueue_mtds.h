@@ -1,9 +1,12 @@
 #pragma once
 
+#include <stdbool.h>
+
 #include "tenant.h"
 
 void local_runqueue_mtds_initialize();
 void local_runqueue_mtds_promote(struct perworker_tenant_sandbox_queue *);
 void local_runqueue_mtds_demote(struct perworker_tenant_sandbox_queue *);
 void local_timeout_queue_add(struct tenant *);
+bool local_timeout_queue_promotion_due();
 void local_timeout_queue_process_promotions();
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <assert.h>
+#include <errno.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "types.h"
+
+/*
+ * A page-aligned buffer backed by an anonymous memory file. The runtime writes into it through a shared mapping,
+ * and the same pages can then be mapped copy-on-write into a sandbox's linear memory without copying them.
+ */
+struct memfd_buffer {
+	int      fd;
+	uint8_t *data;
+	size_t   capacity; /* Rounded up to a page */
+};
+
+/**
+ * @param self
+ * @param size minimum number of bytes the buffer must hold
+ * @returns 0 on success, -1 on error
+ */
+static inline int
+memfd_buffer_init(struct memfd_buffer *self, size_t size)
+{
+	assert(self != NULL);
+	assert(size > 0);
+
+	self->capacity = round_up_to_page(size);
+
+	self->fd = memfd_create("sledge_memfd_buffer", MFD_CLOEXEC);
+	if (self->fd < 0) goto err_create;
+
+	if (ftruncate(self->fd, (off_t)self->capacity) < 0) goto err_truncate;
+
+	self->data = mmap(NULL, self->capacity, PROT_READ | PROT_WRITE, MAP_SHARED, self->fd, 0);
+	if (self->data == MAP_FAILED) goto err_mmap;
+
+	return 0;
+
+err_mmap:
+err_truncate:
+	close(self->fd);
+err_create:
+	self->fd       = -1;
+	self->data     = NULL;
+	self->capacity = 0;
+	return -1;
+}
+
+static inline void
+memfd_buffer_deinit(struct memfd_buffer *self)
+{
+	assert(self != NULL);
+
+	if (self->data == NULL) return;
+
+	munmap(self->data, self->capacity);
+	close(self->fd);
+	self->fd       = -1;
+	self->data     = NULL;
+	self->capacity = 0;
+}
+
+/**
+ * Maps the buffer copy-on-write at a fixed address, replacing whatever was mapped there. Writes through the new
+ * mapping are private and never reach the buffer.
+ * @param self
+ * @param address page-aligned destination, with capacity bytes that the caller owns
+ * @returns 0 on success, -1 on error
+ */
+static inline int
+memfd_buffer_map_private(struct memfd_buffer *self, void *address)
+{
+	assert(self != NULL);
+	assert(self->data != NULL);
+	assert(((uintptr_t)address & (PAGE_SIZE - 1)) == 0);
+
+	void *mapping = mmap(address, self->capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, self->fd, 0);
+	if (mapping == MAP_FAILED) return -1;
+
+	assert(mapping == address);
+	return 0;
+}
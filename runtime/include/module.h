@@ -1,6 +1,9 @@
 #pragma once
 
 #include "current_wasm_module_instance.h"
+#include "memfd_buffer.h"
+#include "module_refiller.h"
+#include "numa_topology.h"
 #include "pool.h"
 #include "sledge_abi_symbols.h"
 #include "types.h"
@@ -8,15 +11,65 @@
 #include "wasm_stack.h"
 
 extern thread_local int worker_thread_idx;
+extern thread_local int listener_thread_idx;
 
 INIT_POOL(wasm_memory, wasm_memory_free)
 INIT_POOL(wasm_stack, wasm_stack_free)
 
+/* Objects move between a thread's pool and its module's depot this many at a time */
+#define MODULE_POOL_BATCH 8
+/* A thread's pool returns its oldest batch to the depot once it holds this many objects of a kind */
+#define MODULE_POOL_CACHE_CAPACITY (2 * MODULE_POOL_BATCH)
+/* How often pools are checked for memory pressure when idle trimming is disabled */
+#define MODULE_POOL_PRESSURE_CHECK_MS 1000
+
+/*
+ * The memory and stack pools are a small cache private to the thread that owns them. The warm pools are topped up
+ * by the refiller thread with prefaulted memories and stacks, so they are locked, and the owner only takes from
+ * them once its cache and the module's depot are empty.
+ *
+ * The idle counts track the fewest objects a cache held since it was last trimmed, so that many objects sat
+ * unused the whole time.
+ */
 struct module_pool {
 	struct wasm_memory_pool memory;
 	struct wasm_stack_pool  stack;
+	uint32_t                memory_count;
+	uint32_t                stack_count;
+	uint32_t                memory_idle;
+	uint32_t                stack_idle;
+	struct wasm_memory_pool warm_memory;
+	struct wasm_stack_pool  warm_stack;
+	_Atomic uint32_t        warm_memory_count;
+	_Atomic uint32_t        warm_stack_count;
+} CACHE_PAD_ALIGNED;
+
+/*
+ * Objects a module's threads do not have room for in their caches, shared by the threads of a NUMA node so that
+ * memories freed on one worker serve another without crossing nodes. Threads take and return whole batches, so the locks are taken once per
+ * MODULE_POOL_BATCH objects. Each pool's lock also protects its count and idle count. The depot holds at most
+ * runtime_pool_capacity objects of each kind.
+ */
+struct module_depot {
+	struct wasm_memory_pool memory;
+	struct wasm_stack_pool  stack;
+	uint32_t                memory_count;
+	uint32_t                stack_count;
+	uint32_t                memory_idle;
+	uint32_t                stack_idle;
+	_Atomic uint64_t        next_trim; /* Cycle count after which a thread may trim the depot again */
 } CACHE_PAD_ALIGNED;
 
+/* Objects held in the caches and depots of all modules, checked against runtime_pool_global_capacity */
+extern _Atomic uint32_t module_pools_pooled;
+/* Objects freed instead of pooled because a pool was full */
+extern _Atomic uint64_t module_pools_dropped_total;
+/* Objects unmapped because they sat idle in a pool */
+extern _Atomic uint64_t module_pools_trimmed_idle_total;
+/* Objects unmapped, and pooled objects whose pages were released, because of memory pressure */
+extern _Atomic uint64_t module_pools_trimmed_pressure_total;
+extern _Atomic uint64_t module_pools_released_pressure_total;
+
 enum module_type
 {
 	APP_MODULE,
@@ -33,7 +86,22 @@ struct module {
 	_Atomic uint32_t               reference_count; /* ref count how many instances exist here. */
 	struct sledge_abi__wasm_table *indirect_table;
 
-	struct module_pool *pools;
+	/* Starting pages of linear memory after initialize_memory, mapped copy-on-write into every instance. No data
+	 * if the snapshot could not be built, in which case each instance runs initialize_memory itself */
+	struct memfd_buffer memory_snapshot;
+
+	/* Warm memories and stacks the refiller keeps in the warm pools of each worker. The largest warm-instances
+	 * of the routes that use the module */
+	uint32_t warm_instances;
+
+	/* Linear memories are backed by transparent huge pages if any route that uses the module asks for them */
+	bool huge_pages;
+
+	/* Stacks commit pages as they grow rather than up front if any route that uses the module asks for it */
+	bool growable_stacks;
+
+	struct module_depot *depots; /* One per NUMA node */
+	struct module_pool  *pools;
 } CACHE_PAD_ALIGNED;
 
 
@@ -43,6 +111,10 @@ struct module {
 
 void           module_free(struct module *module);
 struct module *module_alloc(char *path, enum module_type type, uint32_t stack_size);
+void           module_refill_warm_pools(struct module *module);
+void           module_use_huge_pages(struct module *module);
+void           module_trim_pools(struct module *module, bool trim_idle, bool under_pressure);
+bool           module_pools_under_pressure(void);
 
 /*************************
  * Public Static Inlines *
@@ -108,34 +180,121 @@ module_alloc_table(struct module *module)
 	return 0;
 }
 
+static inline int
+module_pools_count(struct module *module)
+{
+	/* The preprocessing module is executed only by the listener threads, so it gets one pool per listener */
+	return module->type == APP_MODULE ? runtime_worker_threads_count : runtime_listener_threads_count;
+}
+
+/**
+ * Get the pool owned by the calling thread. Pools are private to a thread, so they are accessed without a lock
+ * @param module
+ * @returns the worker's pool for application modules or the listener's pool for preprocessing modules
+ */
+static inline struct module_pool *
+module_get_pool(struct module *module)
+{
+	const int idx = module->type == APP_MODULE ? worker_thread_idx : listener_thread_idx;
+	assert(idx >= 0 && idx < module_pools_count(module));
+	return &module->pools[idx];
+}
+
+/**
+ * Get the depot of the NUMA node of the calling thread
+ * @param module
+ * @returns the depot shared by the threads of the node
+ */
+static inline struct module_depot *
+module_get_depot(struct module *module)
+{
+	assert(numa_topology_local_node >= 0 && numa_topology_local_node < numa_topology_node_count);
+	return &module->depots[numa_topology_local_node];
+}
+
 static inline void
 module_initialize_pools(struct module *module)
 {
-	/* Create only a single pool for the preprocessing module, since it is executed only by the event core. */
-	const int n = module->type == APP_MODULE ? runtime_worker_threads_count : 1;
+	const int n = module_pools_count(module);
 	for (int i = 0; i < n; i++) {
 		wasm_memory_pool_init(&module->pools[i].memory, false);
 		wasm_stack_pool_init(&module->pools[i].stack, false);
+		wasm_memory_pool_init(&module->pools[i].warm_memory, true);
+		wasm_stack_pool_init(&module->pools[i].warm_stack, true);
+		atomic_init(&module->pools[i].warm_memory_count, 0);
+		atomic_init(&module->pools[i].warm_stack_count, 0);
+	}
+
+	for (int i = 0; i < numa_topology_node_count; i++) {
+		wasm_memory_pool_init(&module->depots[i].memory, true);
+		wasm_stack_pool_init(&module->depots[i].stack, true);
+		atomic_init(&module->depots[i].next_trim, 0);
 	}
 }
 
 static inline void
 module_deinitialize_pools(struct module *module)
 {
-	const int n = module->type == APP_MODULE ? runtime_worker_threads_count : 1;
+	const int n = module_pools_count(module);
 	for (int i = 0; i < n; i++) {
 		wasm_memory_pool_deinit(&module->pools[i].memory);
 		wasm_stack_pool_deinit(&module->pools[i].stack);
+		wasm_memory_pool_deinit(&module->pools[i].warm_memory);
+		wasm_stack_pool_deinit(&module->pools[i].warm_stack);
+		atomic_fetch_sub(&module_pools_pooled, module->pools[i].memory_count + module->pools[i].stack_count);
+	}
+
+	for (int i = 0; i < numa_topology_node_count; i++) {
+		wasm_memory_pool_deinit(&module->depots[i].memory);
+		wasm_stack_pool_deinit(&module->depots[i].stack);
+		atomic_fetch_sub(&module_pools_pooled, module->depots[i].memory_count + module->depots[i].stack_count);
 	}
 }
 
 /**
- * Invoke a module's initialize_memory
+ * @returns cycles between trims of the pools, whether to trim idle objects or to check for memory pressure
+ */
+static inline uint64_t
+module_pools_trim_interval(void)
+{
+	uint64_t interval_ms = runtime_pool_idle_trim_ms;
+	if (interval_ms == 0) interval_ms = MODULE_POOL_PRESSURE_CHECK_MS;
+
+	return interval_ms * 1000 * runtime_processor_speed_MHz;
+}
+
+/**
+ * Raises the number of warm instances kept for a module. A module shared by several routes keeps the largest of
+ * their targets. Only application modules are warmed
+ * @param module
+ * @param warm_instances target of one of the routes that use the module
+ */
+static inline void
+module_set_warm_instances(struct module *module, uint32_t warm_instances)
+{
+	if (module->type != APP_MODULE) return;
+	if (warm_instances > module->warm_instances) module->warm_instances = warm_instances;
+}
+
+/**
+ * The refiller is woken once a warm pool holds this many objects or fewer, so it is topped up before it runs dry
+ */
+static inline uint32_t
+module_warm_low_water(struct module *module)
+{
+	return module->warm_instances / 2;
+}
+
+/**
+ * Invoke a module's initialize_memory, unless the linear memories of the module are mapped from its snapshot and
+ * were initialized when they were allocated or recycled
  * @param module - the module whose memory we are initializing
  */
 static inline void
 module_initialize_memory(struct module *module)
 {
+	if (module->memory_snapshot.data != NULL) return;
+
 	module->abi.initialize_memory();
 }
 
@@ -162,33 +321,209 @@ module_release(struct module *module)
 	return;
 }
 
+/**
+ * Takes a prefaulted stack from the warm pool of the calling thread, waking the refiller if the pool runs low
+ * @param module
+ * @param pool the pool of the calling thread
+ * @returns a stack or NULL if the warm pool is empty
+ */
+static inline struct wasm_stack *
+module_take_warm_stack(struct module *module, struct module_pool *pool)
+{
+	if (module->warm_instances == 0) return NULL;
+
+	struct wasm_stack *stack = wasm_stack_pool_remove(&pool->warm_stack);
+	if (stack == NULL) {
+		module_refiller_wakeup();
+		return NULL;
+	}
+
+	uint32_t remaining = atomic_fetch_sub(&pool->warm_stack_count, 1) - 1;
+	if (remaining <= module_warm_low_water(module)) module_refiller_wakeup();
+
+	return stack;
+}
+
+/**
+ * Refills the calling thread's empty stack cache with a batch of stacks from its node's depot
+ * @param module
+ * @param pool the pool of the calling thread
+ * @returns one stack of the batch, or NULL if the depot was empty
+ */
+static inline struct wasm_stack *
+module_depot_take_stacks(struct module *module, struct module_pool *pool)
+{
+	struct module_depot *depot = module_get_depot(module);
+
+	/* Skip the lock in the common case where the depot is empty */
+	if (wasm_stack_pool_is_empty(&depot->stack)) return NULL;
+
+	lock_node_t node = {};
+	lock_lock(&depot->stack.lock, &node);
+
+	struct wasm_stack *stack = wasm_stack_pool_remove_nolock(&depot->stack);
+	uint32_t           taken = 0;
+	if (stack != NULL) {
+		struct wasm_stack *next = NULL;
+		for (taken = 1; taken < MODULE_POOL_BATCH; taken++) {
+			next = wasm_stack_pool_remove_nolock(&depot->stack);
+			if (next == NULL) break;
+			wasm_stack_pool_add_nolock(&pool->stack, next);
+		}
+		depot->stack_count -= taken;
+		if (depot->stack_count < depot->stack_idle) depot->stack_idle = depot->stack_count;
+	}
+
+	lock_unlock(&depot->stack.lock, &node);
+
+	if (stack == NULL) return NULL;
+
+	pool->stack_count += taken - 1;
+	atomic_fetch_sub_explicit(&module_pools_pooled, 1, memory_order_relaxed);
+	return stack;
+}
+
+/**
+ * Moves the oldest batch of stacks in the calling thread's cache to the module's depot. Stacks the depot has no
+ * room for are unmapped
+ * @param module
+ * @param pool the pool of the calling thread
+ */
+static inline void
+module_depot_return_stacks(struct module *module, struct module_pool *pool)
+{
+	struct module_depot *depot = module_get_depot(module);
+	assert(pool->stack_count >= MODULE_POOL_BATCH);
+
+	lock_node_t node = {};
+	lock_lock(&depot->stack.lock, &node);
+
+	uint32_t room = MODULE_POOL_BATCH;
+	if (runtime_pool_capacity > 0) {
+		room = depot->stack_count < runtime_pool_capacity ? runtime_pool_capacity - depot->stack_count : 0;
+		if (room > MODULE_POOL_BATCH) room = MODULE_POOL_BATCH;
+	}
+	for (uint32_t i = 0; i < room; i++) {
+		wasm_stack_pool_add_nolock(&depot->stack, wasm_stack_pool_remove_oldest_nolock(&pool->stack));
+	}
+	depot->stack_count += room;
+
+	lock_unlock(&depot->stack.lock, &node);
+
+	uint32_t dropped = MODULE_POOL_BATCH - room;
+	for (uint32_t i = 0; i < dropped; i++) wasm_stack_free(wasm_stack_pool_remove_oldest_nolock(&pool->stack));
+
+	pool->stack_count -= MODULE_POOL_BATCH;
+	if (pool->stack_count < pool->stack_idle) pool->stack_idle = pool->stack_count;
+	if (dropped > 0) {
+		atomic_fetch_sub_explicit(&module_pools_pooled, dropped, memory_order_relaxed);
+		atomic_fetch_add_explicit(&module_pools_dropped_total, dropped, memory_order_relaxed);
+	}
+}
+
 static inline struct wasm_stack *
 module_allocate_stack(struct module *module)
 {
 	assert(module != NULL);
 
-	struct wasm_stack *stack = wasm_stack_pool_remove_nolock(&module->pools[worker_thread_idx].stack);
+	struct module_pool *pool  = module_get_pool(module);
+	struct wasm_stack  *stack = wasm_stack_pool_remove_nolock(&pool->stack);
+
+	if (stack != NULL) {
+		pool->stack_count--;
+		if (pool->stack_count < pool->stack_idle) pool->stack_idle = pool->stack_count;
+		atomic_fetch_sub_explicit(&module_pools_pooled, 1, memory_order_relaxed);
+	} else {
+		stack = module_depot_take_stacks(module, pool);
+	}
+
+	if (stack == NULL) stack = module_take_warm_stack(module, pool);
 
 	if (stack == NULL) {
-		stack = wasm_stack_alloc(module->stack_size);
+		stack = wasm_stack_alloc(module->stack_size, module->growable_stacks);
 		if (unlikely(stack == NULL)) return NULL;
 	}
 
 	return stack;
 }
 
+/**
+ * @returns true if another object can be pooled under runtime_pool_global_capacity
+ */
+static inline bool
+module_pools_have_room(void)
+{
+	return runtime_pool_global_capacity == 0
+	       || atomic_load_explicit(&module_pools_pooled, memory_order_relaxed) < runtime_pool_global_capacity;
+}
+
+/**
+ * Gives a stack freed on another NUMA node back to the depot of the node it was allocated on. Stacks the depot has
+ * no room for are unmapped
+ * @param module
+ * @param stack
+ * @param numa_node the node the stack was allocated on
+ */
+static inline void
+module_depot_give_stack(struct module *module, struct wasm_stack *stack, int numa_node)
+{
+	struct module_depot *depot = &module->depots[numa_node];
+
+	lock_node_t node = {};
+	lock_lock(&depot->stack.lock, &node);
+	bool has_room = runtime_pool_capacity == 0 || depot->stack_count < runtime_pool_capacity;
+	if (has_room) {
+		wasm_stack_pool_add_nolock(&depot->stack, stack);
+		depot->stack_count++;
+	}
+	lock_unlock(&depot->stack.lock, &node);
+
+	if (has_room) {
+		atomic_fetch_add_explicit(&module_pools_pooled, 1, memory_order_relaxed);
+	} else {
+		wasm_stack_free(stack);
+		atomic_fetch_add_explicit(&module_pools_dropped_total, 1, memory_order_relaxed);
+	}
+}
+
+/**
+ * Pools a stack once its sandbox is freed. A sandbox can finish on a worker of another node than the one that
+ * allocated its stack if it was stolen, in which case the stack goes back to the depot of its own node
+ * @param module
+ * @param stack
+ * @param numa_node the node the stack was allocated on
+ */
 static inline void
-module_free_stack(struct module *module, struct wasm_stack *stack)
+module_free_stack(struct module *module, struct wasm_stack *stack, int numa_node)
 {
+	struct module_pool *pool = module_get_pool(module);
+
+	if (!module_pools_have_room()) {
+		wasm_stack_free(stack);
+		atomic_fetch_add_explicit(&module_pools_dropped_total, 1, memory_order_relaxed);
+		return;
+	}
+
 	wasm_stack_reinit(stack);
-	wasm_stack_pool_add_nolock(&module->pools[worker_thread_idx].stack, stack);
+	if (numa_node != numa_topology_local_node) {
+		module_depot_give_stack(module, stack, numa_node);
+		return;
+	}
+
+	if (pool->stack_count >= MODULE_POOL_CACHE_CAPACITY) module_depot_return_stacks(module, pool);
+	wasm_stack_pool_add_nolock(&pool->stack, stack);
+	pool->stack_count++;
+	atomic_fetch_add_explicit(&module_pools_pooled, 1, memory_order_relaxed);
 }
 
+/**
+ * Allocates a new linear memory of the module's starting size, mapped from the module's snapshot if it has one
+ * @param module
+ * @returns a linear memory or NULL on error
+ */
 static inline struct wasm_memory *
-module_allocate_linear_memory(struct module *module)
+module_create_linear_memory(struct module *module)
 {
-	assert(module != NULL);
-
 	uint64_t starting_bytes = (uint64_t)module->abi.starting_pages * WASM_PAGE_SIZE;
 	uint64_t max_bytes      = (uint64_t)module->abi.max_pages * WASM_PAGE_SIZE;
 
@@ -198,18 +533,209 @@ module_allocate_linear_memory(struct module *module)
 	assert(starting_bytes <= (uint64_t)UINT32_MAX + 1);
 	assert(max_bytes <= (uint64_t)UINT32_MAX + 1);
 
-	struct wasm_memory *linear_memory = wasm_memory_pool_remove_nolock(&module->pools[worker_thread_idx].memory);
+	struct wasm_memory *linear_memory = wasm_memory_alloc(starting_bytes, max_bytes);
+	if (unlikely(linear_memory == NULL)) return NULL;
+
+	/* Without huge pages, the memory still works, just with more TLB misses */
+	if (module->huge_pages && unlikely(wasm_memory_use_huge_pages(linear_memory) < 0))
+		debuglog("Failed to back a linear memory of %s with huge pages\n", module->path);
+
+	if (module->memory_snapshot.data != NULL
+	    && unlikely(memfd_buffer_map_private(&module->memory_snapshot, linear_memory->abi.buffer) < 0)) {
+		wasm_memory_free(linear_memory);
+		return NULL;
+	}
+
+	return linear_memory;
+}
+
+/**
+ * Takes a prefaulted linear memory from the warm pool of the calling thread, waking the refiller if the pool runs
+ * low
+ * @param module
+ * @param pool the pool of the calling thread
+ * @returns a linear memory or NULL if the warm pool is empty
+ */
+static inline struct wasm_memory *
+module_take_warm_linear_memory(struct module *module, struct module_pool *pool)
+{
+	if (module->warm_instances == 0) return NULL;
+
+	struct wasm_memory *linear_memory = wasm_memory_pool_remove(&pool->warm_memory);
 	if (linear_memory == NULL) {
-		linear_memory = wasm_memory_alloc(starting_bytes, max_bytes);
-		if (unlikely(linear_memory == NULL)) return NULL;
+		module_refiller_wakeup();
+		return NULL;
+	}
+
+	uint32_t remaining = atomic_fetch_sub(&pool->warm_memory_count, 1) - 1;
+	if (remaining <= module_warm_low_water(module)) module_refiller_wakeup();
+
+	return linear_memory;
+}
+
+/**
+ * Refills the calling thread's empty linear memory cache with a batch of memories from its node's depot
+ * @param module
+ * @param pool the pool of the calling thread
+ * @returns one linear memory of the batch, or NULL if the depot was empty
+ */
+static inline struct wasm_memory *
+module_depot_take_linear_memories(struct module *module, struct module_pool *pool)
+{
+	struct module_depot *depot = module_get_depot(module);
+
+	/* Skip the lock in the common case where the depot is empty */
+	if (wasm_memory_pool_is_empty(&depot->memory)) return NULL;
+
+	lock_node_t node = {};
+	lock_lock(&depot->memory.lock, &node);
+
+	struct wasm_memory *linear_memory = wasm_memory_pool_remove_nolock(&depot->memory);
+	uint32_t            taken         = 0;
+	if (linear_memory != NULL) {
+		struct wasm_memory *next = NULL;
+		for (taken = 1; taken < MODULE_POOL_BATCH; taken++) {
+			next = wasm_memory_pool_remove_nolock(&depot->memory);
+			if (next == NULL) break;
+			wasm_memory_pool_add_nolock(&pool->memory, next);
+		}
+		depot->memory_count -= taken;
+		if (depot->memory_count < depot->memory_idle) depot->memory_idle = depot->memory_count;
+	}
+
+	lock_unlock(&depot->memory.lock, &node);
+
+	if (linear_memory == NULL) return NULL;
+
+	pool->memory_count += taken - 1;
+	atomic_fetch_sub_explicit(&module_pools_pooled, 1, memory_order_relaxed);
+	return linear_memory;
+}
+
+/**
+ * Moves the oldest batch of linear memories in the calling thread's cache to the module's depot. Memories the
+ * depot has no room for are unmapped
+ * @param module
+ * @param pool the pool of the calling thread
+ */
+static inline void
+module_depot_return_linear_memories(struct module *module, struct module_pool *pool)
+{
+	struct module_depot *depot = module_get_depot(module);
+	assert(pool->memory_count >= MODULE_POOL_BATCH);
+
+	lock_node_t node = {};
+	lock_lock(&depot->memory.lock, &node);
+
+	uint32_t room = MODULE_POOL_BATCH;
+	if (runtime_pool_capacity > 0) {
+		room = depot->memory_count < runtime_pool_capacity ? runtime_pool_capacity - depot->memory_count : 0;
+		if (room > MODULE_POOL_BATCH) room = MODULE_POOL_BATCH;
 	}
+	for (uint32_t i = 0; i < room; i++) {
+		wasm_memory_pool_add_nolock(&depot->memory, wasm_memory_pool_remove_oldest_nolock(&pool->memory));
+	}
+	depot->memory_count += room;
+
+	lock_unlock(&depot->memory.lock, &node);
+
+	uint32_t dropped = MODULE_POOL_BATCH - room;
+	for (uint32_t i = 0; i < dropped; i++) wasm_memory_free(wasm_memory_pool_remove_oldest_nolock(&pool->memory));
+
+	pool->memory_count -= MODULE_POOL_BATCH;
+	if (pool->memory_count < pool->memory_idle) pool->memory_idle = pool->memory_count;
+	if (dropped > 0) {
+		atomic_fetch_sub_explicit(&module_pools_pooled, dropped, memory_order_relaxed);
+		atomic_fetch_add_explicit(&module_pools_dropped_total, dropped, memory_order_relaxed);
+	}
+}
+
+static inline struct wasm_memory *
+module_allocate_linear_memory(struct module *module)
+{
+	assert(module != NULL);
+
+	struct module_pool *pool          = module_get_pool(module);
+	struct wasm_memory *linear_memory = wasm_memory_pool_remove_nolock(&pool->memory);
+
+	if (linear_memory != NULL) {
+		pool->memory_count--;
+		if (pool->memory_count < pool->memory_idle) pool->memory_idle = pool->memory_count;
+		atomic_fetch_sub_explicit(&module_pools_pooled, 1, memory_order_relaxed);
+	} else {
+		linear_memory = module_depot_take_linear_memories(module, pool);
+	}
+
+	if (linear_memory == NULL) linear_memory = module_take_warm_linear_memory(module, pool);
+
+	if (linear_memory == NULL) linear_memory = module_create_linear_memory(module);
 
 	return linear_memory;
 }
 
+/**
+ * Gives a linear memory freed on another NUMA node back to the depot of the node it was allocated on. Memories the
+ * depot has no room for are unmapped
+ * @param module
+ * @param memory
+ * @param numa_node the node the memory was allocated on
+ */
+static inline void
+module_depot_give_linear_memory(struct module *module, struct wasm_memory *memory, int numa_node)
+{
+	struct module_depot *depot = &module->depots[numa_node];
+
+	lock_node_t node = {};
+	lock_lock(&depot->memory.lock, &node);
+	bool has_room = runtime_pool_capacity == 0 || depot->memory_count < runtime_pool_capacity;
+	if (has_room) {
+		wasm_memory_pool_add_nolock(&depot->memory, memory);
+		depot->memory_count++;
+	}
+	lock_unlock(&depot->memory.lock, &node);
+
+	if (has_room) {
+		atomic_fetch_add_explicit(&module_pools_pooled, 1, memory_order_relaxed);
+	} else {
+		wasm_memory_free(memory);
+		atomic_fetch_add_explicit(&module_pools_dropped_total, 1, memory_order_relaxed);
+	}
+}
+
+/**
+ * Recycles a linear memory once its sandbox is done with it, going back to the depot of the node it was allocated on
+ * if that is not the calling thread's node
+ * @param module
+ * @param memory
+ * @param numa_node the node the memory was allocated on
+ */
 static inline void
-module_free_linear_memory(struct module *module, struct wasm_memory *memory)
+module_free_linear_memory(struct module *module, struct wasm_memory *memory, int numa_node)
 {
-	wasm_memory_reinit(memory, module->abi.starting_pages * WASM_PAGE_SIZE);
-	wasm_memory_pool_add_nolock(&module->pools[worker_thread_idx].memory, memory);
+	uint64_t            starting_bytes = (uint64_t)module->abi.starting_pages * WASM_PAGE_SIZE;
+	struct module_pool *pool           = module_get_pool(module);
+
+	if (!module_pools_have_room()) {
+		wasm_memory_free(memory);
+		atomic_fetch_add_explicit(&module_pools_dropped_total, 1, memory_order_relaxed);
+		return;
+	}
+
+	if (module->memory_snapshot.data == NULL) {
+		wasm_memory_reinit(memory, starting_bytes);
+	} else if (unlikely(wasm_memory_reinit_from_snapshot(memory, starting_bytes, &module->memory_snapshot) < 0)) {
+		/* The memory can no longer be restored to the snapshot, so do not recycle it */
+		wasm_memory_free(memory);
+		return;
+	}
+
+	if (numa_node != numa_topology_local_node) {
+		module_depot_give_linear_memory(module, memory, numa_node);
+		return;
+	}
+
+	if (pool->memory_count >= MODULE_POOL_CACHE_CAPACITY) module_depot_return_linear_memories(module, pool);
+	wasm_memory_pool_add_nolock(&pool->memory, memory);
+	pool->memory_count++;
+	atomic_fetch_add_explicit(&module_pools_pooled, 1, memory_order_relaxed);
 }
@@ -0,0 +1,11 @@
+#pragma once
+
+/*
+ * The refiller is a low-priority background thread that keeps the warm pools of modules with warm-instances
+ * topped up with prefaulted linear memories and stacks, so the mmap and page faults of new instances happen off
+ * the request path. It fills the pools once the tenants are loaded, and again whenever a worker drains a warm pool
+ * to its low-water mark.
+ */
+
+void module_refiller_initialize(void);
+void module_refiller_wakeup(void);
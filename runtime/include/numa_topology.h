@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <threads.h>
+
+/* Upper bound on the NUMA nodes the runtime tells apart. Nodes past it are folded into the last one */
+#define NUMA_TOPOLOGY_MAX_NODES 64
+
+/*
+ * The NUMA nodes of the machine, numbered densely from 0 in the order of their kernel ids. Workers are grouped by
+ * node, so the workers of a node have consecutive indices. The global request queues are sharded per node, and
+ * each node keeps its own depot of pooled memories and stacks, so requests and memory stay on the node of the
+ * worker that runs them unless that node runs out of work.
+ *
+ * Machines with a single node, and runtimes started with SLEDGE_DISABLE_NUMA, have one node holding every core.
+ */
+extern uint32_t numa_topology_node_count;
+/* The workers pinned to the cores of each node */
+extern uint32_t numa_topology_node_worker_count[NUMA_TOPOLOGY_MAX_NODES];
+/* The node of the core the calling worker or listener is pinned to. 0 for other threads */
+extern thread_local int numa_topology_local_node;
+
+void numa_topology_initialize(void);
+int  numa_topology_node_of_cpu(int cpu);
+int  numa_topology_bind(void *addr, size_t length, int node);
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <threads.h>
+
+#include "likely.h"
+#include "lock.h"
+
+/*
+ * An object cache keeps freed objects of one type for reuse, so steady-state requests do not touch the allocator.
+ * Each thread caches up to CACHE_CAPACITY objects. Objects are often freed by a different thread than allocated
+ * them, such as a sandbox allocated by a listener and freed by a worker, so a thread whose cache fills moves its
+ * oldest objects to a shared depot in batches, and a thread whose cache is empty refills from the depot. Objects
+ * that fit in neither are returned to the allocator by the caller.
+ *
+ * INIT_OBJECT_CACHE declares the cache in a header and DEFINE_OBJECT_CACHE defines its storage in one translation
+ * unit. Both are zero-initialized, so no setup is needed before first use.
+ */
+
+/* Objects moved between a thread's cache and the depot at once */
+#define OBJECT_CACHE_BATCH 16
+
+#define INIT_OBJECT_CACHE(STRUCT_NAME, CACHE_CAPACITY, DEPOT_CAPACITY)                                            \
+	_Static_assert((CACHE_CAPACITY) >= OBJECT_CACHE_BATCH, "cache must hold a batch");                         \
+	_Static_assert((DEPOT_CAPACITY) >= OBJECT_CACHE_BATCH, "depot must hold a batch");                         \
+                                                                                                                   \
+	struct STRUCT_NAME##_cache {                                                                               \
+		uint32_t            count;                                                                         \
+		struct STRUCT_NAME *objects[CACHE_CAPACITY]; /* Oldest first */                                    \
+	};                                                                                                         \
+                                                                                                                   \
+	struct STRUCT_NAME##_depot {                                                                               \
+		lock_t              lock;                                                                          \
+		_Atomic uint32_t    count;                                                                         \
+		struct STRUCT_NAME *objects[DEPOT_CAPACITY];                                                       \
+	};                                                                                                         \
+                                                                                                                   \
+	extern thread_local struct STRUCT_NAME##_cache STRUCT_NAME##_cache;                                        \
+	extern struct STRUCT_NAME##_depot              STRUCT_NAME##_depot;                                        \
+                                                                                                                   \
+	/* Moves up to a batch of objects from the depot into the calling thread's empty cache */                  \
+	static inline void STRUCT_NAME##_cache_refill(void)                                                        \
+	{                                                                                                          \
+		struct STRUCT_NAME##_cache *cache = &STRUCT_NAME##_cache;                                          \
+		struct STRUCT_NAME##_depot *depot = &STRUCT_NAME##_depot;                                          \
+		assert(cache->count == 0);                                                                         \
+                                                                                                                   \
+		if (atomic_load_explicit(&depot->count, memory_order_relaxed) == 0) return;                        \
+                                                                                                                   \
+		lock_node_t node = {};                                                                             \
+		lock_lock(&depot->lock, &node);                                                                    \
+		uint32_t depot_count = atomic_load_explicit(&depot->count, memory_order_relaxed);                  \
+		uint32_t moved       = depot_count < OBJECT_CACHE_BATCH ? depot_count : OBJECT_CACHE_BATCH;        \
+		depot_count -= moved;                                                                              \
+		memcpy(cache->objects, &depot->objects[depot_count], moved * sizeof(struct STRUCT_NAME *));        \
+		atomic_store_explicit(&depot->count, depot_count, memory_order_relaxed);                           \
+		lock_unlock(&depot->lock, &node);                                                                  \
+                                                                                                                   \
+		cache->count = moved;                                                                              \
+	}                                                                                                          \
+                                                                                                                   \
+	/* Moves the oldest batch of the calling thread's full cache to the depot                                  \
+	 * @returns false if the depot is full */                                                                  \
+	static inline bool STRUCT_NAME##_cache_flush(void)                                                         \
+	{                                                                                                          \
+		struct STRUCT_NAME##_cache *cache = &STRUCT_NAME##_cache;                                          \
+		struct STRUCT_NAME##_depot *depot = &STRUCT_NAME##_depot;                                          \
+		assert(cache->count == (CACHE_CAPACITY));                                                          \
+                                                                                                                   \
+		if (atomic_load_explicit(&depot->count, memory_order_relaxed) > (DEPOT_CAPACITY)-OBJECT_CACHE_BATCH) \
+			return false;                                                                              \
+                                                                                                                   \
+		lock_node_t node = {};                                                                             \
+		lock_lock(&depot->lock, &node);                                                                    \
+		uint32_t depot_count = atomic_load_explicit(&depot->count, memory_order_relaxed);                  \
+		bool     has_room    = depot_count <= (DEPOT_CAPACITY)-OBJECT_CACHE_BATCH;                         \
+		if (has_room) {                                                                                    \
+			memcpy(&depot->objects[depot_count], cache->objects,                                       \
+			       OBJECT_CACHE_BATCH * sizeof(struct STRUCT_NAME *));                                 \
+			atomic_store_explicit(&depot->count, depot_count + OBJECT_CACHE_BATCH,                     \
+			                      memory_order_relaxed);                                               \
+		}                                                                                                  \
+		lock_unlock(&depot->lock, &node);                                                                  \
+		if (!has_room) return false;                                                                       \
+                                                                                                                   \
+		cache->count -= OBJECT_CACHE_BATCH;                                                                \
+		memmove(cache->objects, &cache->objects[OBJECT_CACHE_BATCH],                                       \
+		        cache->count * sizeof(struct STRUCT_NAME *));                                              \
+		return true;                                                                                       \
+	}                                                                                                          \
+                                                                                                                   \
+	/**                                                                                                        \
+	 * Takes the most recently freed object, which is the most likely to still be in the CPU cache             \
+	 * @returns an object in the state it was freed in, or NULL if the caller must allocate one                \
+	 */                                                                                                        \
+	static inline struct STRUCT_NAME *STRUCT_NAME##_cache_take(void)                                           \
+	{                                                                                                          \
+		struct STRUCT_NAME##_cache *cache = &STRUCT_NAME##_cache;                                          \
+		if (unlikely(cache->count == 0)) STRUCT_NAME##_cache_refill();                                     \
+		if (unlikely(cache->count == 0)) return NULL;                                                      \
+		return cache->objects[--cache->count];                                                             \
+	}                                                                                                          \
+                                                                                                                   \
+	/**                                                                                                        \
+	 * Caches a freed object. May be called by a different thread than took or allocated it                   \
+	 * @returns false if there is no room, in which case the caller frees the object                           \
+	 */                                                                                                        \
+	static inline bool STRUCT_NAME##_cache_give(struct STRUCT_NAME *obj)                                       \
+	{                                                                                                          \
+		struct STRUCT_NAME##_cache *cache = &STRUCT_NAME##_cache;                                          \
+		if (unlikely(cache->count == (CACHE_CAPACITY)) && !STRUCT_NAME##_cache_flush()) return false;      \
+		cache->objects[cache->count++] = obj;                                                              \
+		return true;                                                                                       \
+	}
+
+#define DEFINE_OBJECT_CACHE(STRUCT_NAME)                                 \
+	thread_local struct STRUCT_NAME##_cache STRUCT_NAME##_cache = {0}; \
+	struct STRUCT_NAME##_depot              STRUCT_NAME##_depot = {0};
@@ -56,6 +56,23 @@
 		return obj;                                                                                        \
 	}                                                                                                          \
                                                                                                                    \
+	/* Objects are added and removed at the head, so the tail holds the object that was pooled longest ago */  \
+	static inline struct STRUCT_NAME *STRUCT_NAME##_pool_remove_oldest_nolock(struct STRUCT_NAME##_pool *self) \
+	{                                                                                                          \
+		assert(self != NULL);                                                                              \
+		assert(!self->use_lock || lock_is_locked(&self->lock));                                            \
+                                                                                                                   \
+		struct STRUCT_NAME *obj = NULL;                                                                    \
+                                                                                                                   \
+		if (STRUCT_NAME##_pool_is_empty(self)) return obj;                                                 \
+                                                                                                                   \
+		obj = ps_list_head_last_d(&self->list, struct STRUCT_NAME);                                        \
+		assert(obj);                                                                                       \
+		ps_list_rem_d(obj);                                                                                \
+                                                                                                                   \
+		return obj;                                                                                        \
+	}                                                                                                          \
+                                                                                                                   \
 	static inline struct STRUCT_NAME *STRUCT_NAME##_pool_remove(struct STRUCT_NAME##_pool *self)               \
 	{                                                                                                          \
 		assert(self != NULL);                                                                              \
@@ -413,6 +413,20 @@ priority_queue_delete_nolock(struct priority_queue *priority_queue, void *value)
 			priority_queue->items[i]                      = priority_queue->items[priority_queue->size];
 			priority_queue->items[priority_queue->size--] = NULL;
 			priority_queue_percolate_down(priority_queue, i);
+
+			/* The last value may also be smaller than the parent of the deleted one, so shift it upwards */
+			for (; i / 2 != 0 && i <= priority_queue->size
+			       && priority_queue->get_priority_fn(priority_queue->items[i])
+			            < priority_queue->get_priority_fn(priority_queue->items[i / 2]);
+			     i /= 2) {
+				void *temp                   = priority_queue->items[i / 2];
+				priority_queue->items[i / 2] = priority_queue->items[i];
+				priority_queue->items[i]     = temp;
+				if (i / 2 == 1)
+					priority_queue_update_highest_priority(priority_queue,
+					                                       priority_queue->get_priority_fn(
+					                                         priority_queue->items[1]));
+			}
 			return 0;
 		}
 	}
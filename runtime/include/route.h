@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -24,7 +25,12 @@ struct route {
 	/* HTTP State */
 	uint32_t                   relative_deadline_us;
 	uint64_t                   relative_deadline; /* cycles */
+	uint32_t                   quantum_us;        /* 0 means runtime_quantum_us */
 	char                      *response_content_type;
+	char                      *response_header_prefix; /* Status, Server and Content-Type lines of a 200 */
+	size_t                     response_header_prefix_length;
+	bool                       stream_request_body; /* Sandbox starts before the body arrives. See listener */
+	bool                       stream_response;     /* Output is sent in chunks as it is written. See fd_write */
 	struct execution_histogram execution_histogram;
 	struct perf_window         latency;
 	struct module             *module_proprocess;
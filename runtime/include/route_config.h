@@ -22,6 +22,12 @@ enum route_config_member
 	route_config_member_model_beta2,
 	route_config_member_http_resp_content_type,
 	route_config_member_stack_size,
+	route_config_member_stream_request_body,
+	route_config_member_stream_response,
+	route_config_member_warm_instances,
+	route_config_member_huge_pages,
+	route_config_member_stack_growable,
+	route_config_member_quantum_us,
 	route_config_member_len
 };
 
@@ -38,6 +44,12 @@ struct route_config {
 	uint32_t model_beta2;
 	char    *http_resp_content_type;
 	uint32_t stack_size; /* in bytes; 0 means use the runtime default (WASM_STACK_SIZE) */
+	bool     stream_request_body; /* Dispatch the sandbox once the headers arrive, before the whole body */
+	bool     stream_response;     /* Send output in chunks while the sandbox runs, without a Content-Length */
+	uint32_t warm_instances;      /* Memories and stacks the refiller keeps prefaulted for each worker */
+	bool     huge_pages;          /* Back linear memory with transparent huge pages */
+	bool     stack_growable;      /* Commit stack pages on demand beneath a guard page */
+	uint32_t quantum_us;          /* Preemption quantum of the route's sandboxes; 0 means SLEDGE_QUANTUM_US */
 };
 
 static inline void
@@ -60,6 +72,12 @@ route_config_print(struct route_config *config)
 	printf("[Route] Relative Deadline (us): %u\n", config->relative_deadline_us);
 	printf("[Route] HTTP Response Content Type: %s\n", config->http_resp_content_type);
 	printf("[Route] Stack Size (bytes, 0=default): %u\n", config->stack_size);
+	printf("[Route] Stream Request Body: %s\n", config->stream_request_body ? "true" : "false");
+	printf("[Route] Stream Response: %s\n", config->stream_response ? "true" : "false");
+	printf("[Route] Warm Instances: %u\n", config->warm_instances);
+	printf("[Route] Huge Pages: %s\n", config->huge_pages ? "true" : "false");
+	printf("[Route] Stack Growable: %s\n", config->stack_growable ? "true" : "false");
+	printf("[Route] Quantum (us, 0=default): %u\n", config->quantum_us);
 #ifdef EXECUTION_HISTOGRAM
 	printf("[Route] Path of Preprocessing Module: %s\n", config->path_preprocess);
 	printf("[Route] Model Bias: %u\n", config->model_bias);
@@ -105,6 +123,11 @@ route_config_validate(struct route_config *config, bool *did_set)
 		}
 	}
 
+	if (config->quantum_us > 999999) {
+		fprintf(stderr, "quantum-us must be at most 999999, was %u\n", config->quantum_us);
+		return -1;
+	}
+
 #ifdef EXECUTION_HISTOGRAM
 	if (config->admissions_percentile > 99 || config->admissions_percentile < 50) {
 		fprintf(stderr, "admissions-percentile must be > 50 and <= 99 but was %u, defaulting to 70\n",
@@ -9,7 +9,9 @@
 static const char *route_config_json_keys[route_config_member_len] =
   {"route",           "path",        "admissions-percentile", "relative-deadline-us",
    "path_preprocess", "model-bias",  "model-scale",           "model-num-of-param",
-   "model-beta1",     "model-beta2", "http-resp-content-type", "stack-size"};
+   "model-beta1",     "model-beta2", "http-resp-content-type", "stack-size",
+   "stream-request-body", "stream-response", "warm-instances", "huge-pages",
+   "stack-growable", "quantum-us"};
 
 static inline int
 route_config_set_key_once(bool *did_set, enum route_config_member member)
@@ -140,6 +142,54 @@ route_config_parse(struct route_config *config, const char *json_buf, jsmntok_t
 			                        route_config_json_keys[route_config_member_stack_size],
 			                        &config->stack_size);
 			if (rc < 0) return -1;
+		} else if (strcmp(key, route_config_json_keys[route_config_member_stream_request_body]) == 0) {
+			if (!has_valid_type(tokens[i], key, JSMN_PRIMITIVE, json_buf)) return -1;
+			if (route_config_set_key_once(did_set, route_config_member_stream_request_body) == -1)
+				return -1;
+
+			int rc = parse_bool(tokens[i], json_buf,
+			                    route_config_json_keys[route_config_member_stream_request_body],
+			                    &config->stream_request_body);
+			if (rc < 0) return -1;
+		} else if (strcmp(key, route_config_json_keys[route_config_member_stream_response]) == 0) {
+			if (!has_valid_type(tokens[i], key, JSMN_PRIMITIVE, json_buf)) return -1;
+			if (route_config_set_key_once(did_set, route_config_member_stream_response) == -1) return -1;
+
+			int rc = parse_bool(tokens[i], json_buf,
+			                    route_config_json_keys[route_config_member_stream_response],
+			                    &config->stream_response);
+			if (rc < 0) return -1;
+		} else if (strcmp(key, route_config_json_keys[route_config_member_warm_instances]) == 0) {
+			if (!has_valid_type(tokens[i], key, JSMN_PRIMITIVE, json_buf)) return -1;
+			if (route_config_set_key_once(did_set, route_config_member_warm_instances) == -1) return -1;
+
+			int rc = parse_uint32_t(tokens[i], json_buf,
+			                        route_config_json_keys[route_config_member_warm_instances],
+			                        &config->warm_instances);
+			if (rc < 0) return -1;
+		} else if (strcmp(key, route_config_json_keys[route_config_member_huge_pages]) == 0) {
+			if (!has_valid_type(tokens[i], key, JSMN_PRIMITIVE, json_buf)) return -1;
+			if (route_config_set_key_once(did_set, route_config_member_huge_pages) == -1) return -1;
+
+			int rc = parse_bool(tokens[i], json_buf, route_config_json_keys[route_config_member_huge_pages],
+			                    &config->huge_pages);
+			if (rc < 0) return -1;
+		} else if (strcmp(key, route_config_json_keys[route_config_member_stack_growable]) == 0) {
+			if (!has_valid_type(tokens[i], key, JSMN_PRIMITIVE, json_buf)) return -1;
+			if (route_config_set_key_once(did_set, route_config_member_stack_growable) == -1) return -1;
+
+			int rc = parse_bool(tokens[i], json_buf,
+			                    route_config_json_keys[route_config_member_stack_growable],
+			                    &config->stack_growable);
+			if (rc < 0) return -1;
+		} else if (strcmp(key, route_config_json_keys[route_config_member_quantum_us]) == 0) {
+			if (!has_valid_type(tokens[i], key, JSMN_PRIMITIVE, json_buf)) return -1;
+			if (route_config_set_key_once(did_set, route_config_member_quantum_us) == -1) return -1;
+
+			int rc = parse_uint32_t(tokens[i], json_buf,
+			                        route_config_json_keys[route_config_member_quantum_us],
+			                        &config->quantum_us);
+			if (rc < 0) return -1;
 		} else {
 			fprintf(stderr, "%s is not a valid key\n", key);
 			return -1;
@@ -28,6 +28,7 @@
 #define RUNTIME_RELATIVE_DEADLINE_US_MAX 3600000000 /* One Hour. Fits in uint32_t */
 #define RUNTIME_RUNQUEUE_SIZE            256        /* Minimum guaranteed size. Might grow! */
 #define RUNTIME_TENANT_QUEUE_SIZE        4096
+#define RUNTIME_QUANTUM_MIN_US           50 /* Shortest quantum a tickless worker arms its timer for */
 
 enum RUNTIME_SIGALRM_HANDLER
 {
@@ -35,16 +36,37 @@ enum RUNTIME_SIGALRM_HANDLER
 	RUNTIME_SIGALRM_HANDLER_TRIAGED   = 1
 };
 
+/* What a worker thread runs, published for the other threads. Padded so that a worker switching sandboxes does not
+ * invalidate the slots of the others */
+struct runtime_worker_slot {
+	uint64_t deadline;       /* Absolute deadline of the running sandbox. UINT64_MAX while idle or scheduling */
+	uint64_t remaining_exec; /* Estimated execution left to the running sandbox when it was switched to */
+} CACHE_PAD_ALIGNED;
+
 extern pid_t                        runtime_pid;
 extern bool                         runtime_preemption_enabled;
 extern bool                         runtime_worker_spinloop_pause_enabled;
+extern bool                         runtime_work_stealing_enabled;
+extern bool                         runtime_tickless_enabled;
+extern bool                         runtime_arrival_preemption_enabled;
 extern uint32_t                     runtime_processor_speed_MHz;
 extern uint32_t                     runtime_quantum_us;
+extern uint64_t                     runtime_min_relative_deadline;
 extern enum RUNTIME_SIGALRM_HANDLER runtime_sigalrm_handler;
 extern pthread_t                   *runtime_worker_threads;
 extern uint32_t                     runtime_worker_threads_count;
+extern uint32_t                     runtime_listener_threads_count;
+extern uint32_t                     runtime_http_keep_alive_timeout_ms;
+extern uint32_t                     runtime_http_keep_alive_max_requests;
+extern uint32_t                     runtime_request_body_memfd_threshold;
+extern uint32_t                     runtime_response_chunk_size;
+extern uint32_t                     runtime_pool_capacity;
+extern uint32_t                     runtime_pool_global_capacity;
+extern uint32_t                     runtime_pool_idle_trim_ms;
+extern uint32_t                     runtime_pool_rss_limit_mb;
 extern int                         *runtime_worker_threads_argument;
-extern uint64_t                    *runtime_worker_threads_deadline;
+extern struct runtime_worker_slot  *runtime_worker_slots;
+extern int                         *runtime_worker_threads_numa_node;
 extern uint64_t                     runtime_boot_timestamp;
 
 extern void runtime_initialize(void);
@@ -28,7 +28,17 @@ sandbox_free_linear_memory(struct sandbox *sandbox)
 {
 	assert(sandbox != NULL);
 	assert(sandbox->memory != NULL);
-	module_free_linear_memory(sandbox->module, (struct wasm_memory *)sandbox->memory);
+
+	/* Swap a mapped request body back to anonymous memory so the memfd pages are not recycled with the memory */
+	if (sandbox->request_body_mapping_size > 0) {
+		void *body    = &sandbox->memory->abi.buffer[sandbox->request_body_offset];
+		void *mapping = mmap(body, sandbox->request_body_mapping_size, PROT_READ | PROT_WRITE,
+		                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+		if (unlikely(mapping == MAP_FAILED)) panic("Failed to unmap request body: %s\n", strerror(errno));
+		sandbox->request_body_mapping_size = 0;
+	}
+
+	module_free_linear_memory(sandbox->module, (struct wasm_memory *)sandbox->memory, sandbox->numa_node);
 	sandbox->memory = NULL;
 }
 
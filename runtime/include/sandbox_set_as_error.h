@@ -65,10 +65,17 @@ sandbox_set_as_error(struct sandbox *sandbox, sandbox_state_t last_state)
 	admissions_control_subtract(sandbox->admissions_estimate);
 #endif
 
-	/* Return HTTP session to listener core to be written back to client */
-	http_session_set_response_header(sandbox->http, 500);
-	sandbox->http->state = HTTP_SESSION_EXECUTION_COMPLETE;
-	http_session_send_response(sandbox->http, (void_star_cb)listener_thread_register_http_session);
+	if (sandbox->http->response_streaming) {
+		/* Part of a 200 was already sent, so the client learns of the error from the missing last chunk */
+		http_session_close(sandbox->http);
+		http_session_free(sandbox->http);
+	} else {
+		/* Return HTTP session to listener core to be written back to client */
+		http_session_set_response_header(sandbox->http, 500);
+		sandbox->http->state = HTTP_SESSION_EXECUTION_COMPLETE;
+		http_session_send_response(sandbox->http, (void_star_cb)listener_thread_register_http_session,
+		                           (void_star_cb)listener_thread_register_http_session);
+	}
 	sandbox->http = NULL;
 
 	/* Terminal State Logging */
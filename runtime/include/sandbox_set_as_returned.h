@@ -4,7 +4,6 @@
 #include <stdint.h>
 
 #include "arch/getcycles.h"
-#include "auto_buf.h"
 #include "listener_thread.h"
 #include "local_runqueue.h"
 #include "panic.h"
@@ -54,9 +53,16 @@ sandbox_set_as_returned(struct sandbox *sandbox, sandbox_state_t last_state)
 	sandbox_state_totals_increment(SANDBOX_RETURNED);
 	sandbox_state_totals_decrement(last_state);
 
-	http_session_set_response_header(sandbox->http, 200);
+	/* Once a streaming response sent its header, only the last chunk is left */
+	if (sandbox->http->response_streaming) {
+		if (unlikely(http_session_frame_response_chunk(sandbox->http, true) < 0))
+			panic("failed to frame last response chunk\n");
+	} else {
+		http_session_set_response_header(sandbox->http, 200);
+	}
 	sandbox->http->state = HTTP_SESSION_EXECUTION_COMPLETE;
-	http_session_send_response(sandbox->http, (void_star_cb)listener_thread_register_http_session);
+	http_session_send_response(sandbox->http, (void_star_cb)listener_thread_register_http_session,
+	                           (void_star_cb)listener_thread_register_http_session);
 	sandbox->http = NULL;
 
 	/* State Change Hooks */
@@ -25,7 +25,7 @@ sandbox_set_as_running_sys(struct sandbox *sandbox, sandbox_state_t last_state)
 	switch (last_state) {
 	case SANDBOX_RUNNING_USER: {
 		assert(sandbox == current_sandbox_get());
-		assert(runtime_worker_threads_deadline[worker_thread_idx] == sandbox->absolute_deadline);
+		assert(runtime_worker_slots[worker_thread_idx].deadline == sandbox->absolute_deadline);
 		break;
 	}
 	case SANDBOX_RUNNABLE: {
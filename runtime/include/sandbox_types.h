@@ -1,8 +1,11 @@
 #pragma once
 
+#include <assert.h>
+#include <stddef.h>
 #include <stdint.h>
 
 #include "arch/context.h"
+#include "arena.h"
 #include "http_session.h"
 #include "module.h"
 #include "ps_list.h"
@@ -31,39 +34,42 @@ struct sandbox_timestamps {
 };
 
 struct sandbox {
+	/*
+	 * Fields read on every scheduling decision and state transition come first, so they share the first
+	 * CACHE_PAD bytes of the page-aligned sandbox. Keep this group within CACHE_PAD. See the assertion below
+	 */
+
 	/* used by ps_list's default name-based MACROS for the scheduling runqueue */
 	/* Keep as first member of sandbox struct to ensure ps_list maintains alignment */
 	struct ps_list list;
 
-	uint64_t                     id;
-	sandbox_state_t              state;
-	struct sandbox_state_history state_history;
-	uint16_t                     response_code;
-
-
-	/* Accounting Info */
-	struct route  *route;
-	struct tenant *tenant;
-
-	/* HTTP State */
-	struct http_session *http;
-
-	/* WebAssembly Module State */
-	struct module *module; /* the module this is an instance of */
+	sandbox_state_t           state;
+	uint64_t                  id;
+	uint64_t                  absolute_deadline;
+	uint64_t                  remaining_exec;
+	uint64_t                  last_state_duration;
+	struct sandbox_timestamps timestamp_of;
+	struct module            *module; /* the module this is an instance of */
+	struct tenant            *tenant;
+	struct route             *route;
+	struct sandbox           *wakeup_next; /* Links the sandbox into a worker_wakeup_queue while it is woken up */
 
 	/* WebAssembly Instance State  */
 	struct arch_context      ctxt;
 	struct wasm_stack       *stack;
 	struct wasm_memory      *memory;
 	struct vec_wasm_global_t globals;
+	int                      numa_node; /* Node the stack and memory came from, where they go back when freed */
 
-	/* Scheduling and Temporal State */
-	struct sandbox_timestamps timestamp_of;
-	uint64_t                  duration_of_state[SANDBOX_STATE_COUNT];
-	uint64_t                  last_state_duration;
+	/* HTTP State */
+	struct http_session *http;
+	uint16_t             response_code;
+
+	/* Request body placed in linear memory by the request_body hostcall. Length is 0 until then */
+	uint32_t request_body_offset;
+	uint32_t request_body_length;
+	size_t   request_body_mapping_size; /* Non-zero if the body pages are a private mapping of a memfd_buffer */
 
-	uint64_t remaining_exec;
-	uint64_t absolute_deadline;
 	uint64_t admissions_estimate; /* estimated execution time (cycles) * runtime_admissions_granularity / relative
 	                                 deadline (cycles) */
 	uint64_t total_time;          /* Total time from Request to Response */
@@ -74,4 +80,18 @@ struct sandbox {
 	int32_t         return_value;
 	wasi_context_t *wasi_context;
 
+	/* Cold accounting, only read when a sandbox is logged or summarized */
+	struct sandbox_state_history state_history;
+	uint64_t                     duration_of_state[SANDBOX_STATE_COUNT];
+
+	/* Host scratch memory for hostcalls and the WASI context. Reset when the sandbox is freed. Keep last, so the
+	 * arena's buffer is not zeroed when the sandbox is allocated. The sandbox spans more than one page, mostly for
+	 * the copy of the floating point state in ctxt, and the arena is sized to fit in the slack of its last page */
+	struct arena arena;
 } PAGE_ALIGNED;
+
+#ifndef LOG_SANDBOX_MEMORY_PROFILE
+static_assert(offsetof(struct sandbox, ctxt) <= CACHE_PAD, "scheduler-hot sandbox fields must fit in CACHE_PAD");
+static_assert(round_up_to_page(offsetof(struct sandbox, arena)) == sizeof(struct sandbox),
+              "the sandbox arena must not add a page to the sandbox");
+#endif
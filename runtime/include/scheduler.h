@@ -23,6 +23,8 @@
 #include "sandbox_set_as_running_user.h"
 #include "sandbox_types.h"
 #include "scheduler_options.h"
+#include "worker_thread.h"
+#include "worker_wakeup_queue.h"
 
 
 /**
@@ -36,31 +38,27 @@
  * mcontext structure saved during the last preemption. Otherwise, the cooperative scheduler triggers a "fast switch",
  * which only updates the instruction and stack pointer.
  *
- * Preemptive scheduler is provided by POSIX timers using a set interval defining a scheduling quantum. Our signal
- * handler is configured to mask nested signals. Given that POSIX specifies that the kernel only delivers a SIGALRM to a
- * single thread, the lucky thread that receives the kernel thread has the responsibility of propagating this signal
- * onto all other worker threads. This must occur even when a worker thread is running a sandbox in a nonpreemptable
- * state.
+ * Preemptive scheduler is provided by POSIX timers using a set interval defining a scheduling quantum. Each worker
+ * owns a timer that delivers its SIGALRM to that worker alone, so no worker forwards signals to the others. Our signal
+ * handler is configured to mask nested signals.
  *
  * When a SIGALRM fires, a worker can be in one of four states:
  *
- * 1) "Running a signal handler" - We mask signals when we are executing a signal handler, which results in signals
- * being ignored. A kernel signal should get delivered to another unmasked worker, so propagation still occurs.
+ * 1) "Running a signal handler" - We mask signals when we are executing a signal handler, so the SIGALRM stays
+ * pending until the handler returns.
  *
  * 2) "Running the Cooperative Scheduler" - This is signified by the thread local current_sandbox being set to NULL. We
- * propagate the signal and return immediately because we know we're already in the scheduler. We have no sandboxes to
- * interrupt, so no sandbox state transitions occur.
+ * return immediately because we know we're already in the scheduler. We have no sandboxes to interrupt, so no sandbox
+ * state transitions occur.
  *
- * 3) "Running a Sandbox in a state other than SANDBOX_RUNNING_USER" - We call sandbox_interrupt on current_sandbox,
- * propagate the sigalrms to the other workers, defer the sigalrm locally, and then return. The SANDBOX_INTERRUPTED
- * timekeeping data is increased to account for the time needed to propagate the sigalrms.
+ * 3) "Running a Sandbox in a state other than SANDBOX_RUNNING_USER" - We defer the sigalrm locally and return. It is
+ * replayed once the sandbox returns to SANDBOX_RUNNING_USER.
  *
- * 4) "Running a Sandbox in the SANDBOX_RUNNING_USER state - We call sandbox_interrupt on current_sandbox, propagate
- * the sigalrms to the other workers, and then actually enter the scheduler via scheduler_preemptive_sched. The
- * interrupted sandbox may either be preempted or return to depending on the scheduler. If preempted, the interrupted
- * mcontext is saved to the sandbox structure. The SANDBOX_INTERRUPTED timekeeping data is increased to account for the
- * time needed to propagate the sigalrms, run epoll, query the scheduler data structure, and (potentially) allocate and
- * initialize a sandbox.
+ * 4) "Running a Sandbox in the SANDBOX_RUNNING_USER state - We call sandbox_interrupt on current_sandbox and then
+ * actually enter the scheduler via scheduler_preemptive_sched. The interrupted sandbox may either be preempted or
+ * return to depending on the scheduler. If preempted, the interrupted mcontext is saved to the sandbox structure. The
+ * SANDBOX_INTERRUPTED timekeeping data is increased to account for the time needed to run epoll, query the scheduler
+ * data structure, and (potentially) allocate and initialize a sandbox.
  */
 
 static inline struct sandbox *
@@ -180,23 +178,53 @@ done:
 	return local_runqueue_get_next();
 }
 
+/**
+ * Called when the worker has nothing in its runqueue and nothing to pull from the global request scheduler, so
+ * steals a runnable sandbox that has not started from another worker's runqueue
+ * @returns the head of the local runqueue, or NULL if nothing could be stolen
+ */
+static inline struct sandbox *
+scheduler_steal()
+{
+	struct sandbox *stolen = local_runqueue_steal();
+	if (stolen == NULL) return NULL;
+
+	assert(stolen->state == SANDBOX_RUNNABLE);
+	local_runqueue_add(stolen);
+	return local_runqueue_get_next();
+}
+
 static inline struct sandbox *
 scheduler_get_next()
 {
+	/* Sandboxes woken up by other threads become runnable before the policy picks */
+	worker_wakeup_queue_drain();
+
+	struct sandbox *next = NULL;
+
 	switch (scheduler) {
 	case SCHEDULER_MTDBF:
-		return scheduler_mtdbf_get_next();
+		next = scheduler_mtdbf_get_next();
+		break;
 	case SCHEDULER_MTDS:
-		return scheduler_mtds_get_next();
+		next = scheduler_mtds_get_next();
+		break;
 	case SCHEDULER_SJF:
-		return scheduler_sjf_get_next();
+		next = scheduler_sjf_get_next();
+		break;
 	case SCHEDULER_EDF:
-		return scheduler_edf_get_next();
+		next = scheduler_edf_get_next();
+		break;
 	case SCHEDULER_FIFO:
-		return scheduler_fifo_get_next();
+		next = scheduler_fifo_get_next();
+		break;
 	default:
 		panic("Unimplemented\n");
 	}
+
+	if (next == NULL && runtime_work_stealing_enabled) next = scheduler_steal();
+
+	return next;
 }
 
 static inline void
@@ -219,6 +247,8 @@ scheduler_initialize()
 	default:
 		panic("Invalid scheduler policy: %u\n", scheduler);
 	}
+
+	local_runqueue_slots_initialize();
 }
 
 static inline void
@@ -281,6 +311,66 @@ scheduler_log_sandbox_switch(struct sandbox *current_sandbox, struct sandbox *ne
 #endif
 }
 
+/**
+ * Picks how long a sandbox may run before the next SIGALRM on a tickless worker. EDF and SJF already run the best
+ * sandbox of the local and global queues, so only requests that arrive later can preempt it. The quantum is cut to
+ * the time during which such a request still could, which the head of the runqueue, the running sandbox, runs out of
+ * as its deadline nears (EDF) or its remaining execution runs down (SJF). Round robin only has to preempt while other
+ * sandboxes share the runqueue.
+ * @param sandbox the sandbox about to run
+ * @returns microseconds until the next SIGALRM, or 0 if no SIGALRM could preempt the sandbox
+ */
+static inline uint32_t
+scheduler_quantum_us(struct sandbox *sandbox)
+{
+	uint32_t quantum_us = sandbox->route->quantum_us > 0 ? sandbox->route->quantum_us : runtime_quantum_us;
+	uint64_t window     = 0; /* cycles during which an arrival could preempt the sandbox */
+
+	switch (scheduler) {
+	case SCHEDULER_EDF: {
+		/* A request arriving now has a deadline no earlier than now + runtime_min_relative_deadline */
+		if (runtime_min_relative_deadline == UINT64_MAX) return 0;
+		uint64_t earliest_arrival_deadline = __getcycles() + runtime_min_relative_deadline;
+		if (sandbox->absolute_deadline <= earliest_arrival_deadline) return 0;
+		window = sandbox->absolute_deadline - earliest_arrival_deadline;
+		break;
+	}
+	case SCHEDULER_SJF: {
+		window = sandbox->remaining_exec;
+		if (window == 0) return 0;
+		break;
+	}
+	case SCHEDULER_FIFO: {
+		struct local_runqueue_slot *slot = &local_runqueue_slots[worker_thread_idx];
+		return atomic_load_explicit(&slot->length, memory_order_relaxed) > 1 ? quantum_us : 0;
+	}
+	default:
+		return runtime_quantum_us;
+	}
+
+	uint64_t window_us = window / runtime_processor_speed_MHz;
+	if (window_us < RUNTIME_QUANTUM_MIN_US) window_us = RUNTIME_QUANTUM_MIN_US;
+	return window_us < quantum_us ? (uint32_t)window_us : quantum_us;
+}
+
+/**
+ * Arms the timer of a tickless worker for the sandbox it is about to run, or disarms it while the worker is idle
+ * @param sandbox the sandbox about to run or NULL
+ */
+static inline void
+scheduler_arm_quantum(struct sandbox *sandbox)
+{
+	if (!runtime_tickless_enabled) return;
+
+	uint32_t quantum_us = sandbox == NULL ? 0 : scheduler_quantum_us(sandbox);
+	software_interrupt_set_timer(quantum_us);
+
+	/* A sandbox woken after the scheduler drained the wakeup queue, but before the timer was disarmed, found the
+	 * timer still armed and did not kick the worker */
+	if (quantum_us == 0 && sandbox != NULL && !worker_wakeup_queue_is_empty())
+		software_interrupt_set_timer(RUNTIME_QUANTUM_MIN_US);
+}
+
 static inline void
 scheduler_preemptive_switch_to(ucontext_t *interrupted_context, struct sandbox *next)
 {
@@ -355,6 +445,8 @@ scheduler_preemptive_sched(ucontext_t *interrupted_context)
 	/* Assumption: the current sandbox is on the runqueue, so the scheduler should always return something */
 	assert(next != NULL);
 
+	scheduler_arm_quantum(next);
+
 	/* If current equals next, no switch is necessary, so resume execution */
 	if (interrupted_sandbox == next) {
 		sandbox_interrupt_return(interrupted_sandbox, SANDBOX_RUNNING_USER);
@@ -408,6 +500,7 @@ scheduler_cooperative_switch_to(struct arch_context *current_context, struct san
 		      sandbox_state_stringify(next_sandbox->state));
 	}
 	}
+	scheduler_arm_quantum(next_sandbox);
 	arch_context_switch(current_context, next_context);
 }
 
@@ -416,6 +509,7 @@ scheduler_switch_to_base_context(struct arch_context *current_context)
 {
 	/* Assumption: Base Worker context should never be preempted */
 	assert(worker_thread_base_context.variant == ARCH_CONTEXT_VARIANT_FAST);
+	scheduler_arm_quantum(NULL);
 	arch_context_switch(current_context, &worker_thread_base_context);
 }
 
@@ -440,6 +534,9 @@ scheduler_idle_loop()
 		/* Clear the cleanup queue */
 		local_cleanup_queue_free();
 
+		/* Release pooled memories and stacks that are no longer needed */
+		worker_thread_trim_pools();
+
 		/* Improve the performance of spin-wait loops (works only if preemptions enabled) */
 		if (runtime_worker_spinloop_pause_enabled) pause();
 	}
@@ -481,6 +578,7 @@ scheduler_cooperative_sched(bool add_to_cleanup_queue)
 	if (next_sandbox == exiting_sandbox) {
 		sandbox_set_as_running_sys(next_sandbox, SANDBOX_RUNNABLE);
 		current_sandbox_set(next_sandbox);
+		scheduler_arm_quantum(next_sandbox);
 		return;
 	}
 
@@ -500,11 +598,53 @@ scheduler_cooperative_sched(bool add_to_cleanup_queue)
 }
 
 
+/**
+ * Under MTDS, the interrupt path promotes tenants whose timers ran out, and get_next demotes a guaranteed tenant that
+ * ran out of budget before it pulls from the global queues by the class of the local head
+ */
 static inline bool
-scheduler_worker_would_preempt(int worker_idx)
+scheduler_mtds_would_preempt(struct runtime_worker_slot *slot)
 {
-	assert(scheduler == SCHEDULER_EDF);
-	uint64_t local_deadline  = runtime_worker_threads_deadline[worker_idx];
-	uint64_t global_deadline = global_request_scheduler_peek();
-	return global_deadline < local_deadline;
+	if (local_timeout_queue_promotion_due()) return true;
+
+	struct sandbox *current             = current_sandbox_get();
+	uint64_t        guaranteed_deadline = global_request_scheduler_mtds_guaranteed_peek();
+
+	if (current->tenant->pwt_sandboxes[worker_thread_idx].mt_class == MT_GUARANTEED) {
+		/* The budget is only charged when the sandbox leaves its state, so charge the run so far */
+		int64_t ran = (int64_t)(__getcycles() - current->timestamp_of.last_state_change);
+		if (atomic_load(&current->tenant->remaining_budget) <= ran) return true;
+		return guaranteed_deadline < slot->deadline;
+	}
+
+	return guaranteed_deadline != UINT64_MAX || global_request_scheduler_mtds_default_peek() < slot->deadline;
+}
+
+/**
+ * Decides whether a SIGALRM should run the scheduler of the calling worker, for triaged SIGALRM handlers. Each
+ * policy checks whether its get_next could pick something other than the sandbox the worker published in its slot
+ * @returns true if the scheduler might preempt the running sandbox
+ */
+static inline bool
+scheduler_worker_would_preempt(void)
+{
+	struct runtime_worker_slot *slot = &runtime_worker_slots[worker_thread_idx];
+
+	/* Woken sandboxes only reach the runqueue in the scheduler */
+	if (!worker_wakeup_queue_is_empty()) return true;
+
+	switch (scheduler) {
+	case SCHEDULER_EDF:
+		return global_request_scheduler_peek() < slot->deadline;
+	case SCHEDULER_SJF:
+		/* The slot holds the remaining execution as of the switch, so this errs towards preempting */
+		return global_request_scheduler_peek() < slot->remaining_exec;
+	case SCHEDULER_FIFO:
+		/* The global queue is only pulled from once the runqueue is empty, so only round robin preempts */
+		return atomic_load_explicit(&local_runqueue_slots[worker_thread_idx].length, memory_order_relaxed) > 1;
+	case SCHEDULER_MTDS:
+		return scheduler_mtds_would_preempt(slot);
+	default:
+		return true;
+	}
 }
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <assert.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <threads.h>
+
+#include "likely.h"
+
+/*
+ * A slab_buffer is an append-only byte buffer built from a chain of fixed-size slabs. Growing never moves data that
+ * was already written, and the contents are exported as an iovec array so they can be sent with a single writev.
+ * Slabs come from a per-thread cache, so steady-state requests do not touch the allocator.
+ */
+
+#define SLAB_SIZE          (16 * 1024) /* Bytes per slab, including the slab header */
+#define SLAB_POOL_CAPACITY 128         /* Slabs cached by each thread. Extra slabs are returned to the allocator */
+
+struct slab {
+	struct slab *next;
+	size_t       length; /* Bytes of data written */
+	char         data[];
+};
+
+#define SLAB_DATA_CAPACITY (SLAB_SIZE - offsetof(struct slab, data))
+
+struct slab_pool {
+	struct slab *head;
+	uint32_t     count;
+};
+
+extern thread_local struct slab_pool slab_pool;
+
+struct slab_buffer {
+	struct slab *head;
+	struct slab *tail;
+	size_t       size; /* Total bytes written across all slabs */
+};
+
+/**
+ * Takes an empty slab from the calling thread's cache, falling back to the allocator
+ * @returns slab or NULL on allocation failure
+ */
+static inline struct slab *
+slab_alloc(void)
+{
+	struct slab *slab = slab_pool.head;
+	if (likely(slab != NULL)) {
+		slab_pool.head = slab->next;
+		slab_pool.count--;
+	} else {
+		slab = malloc(SLAB_SIZE);
+		if (unlikely(slab == NULL)) return NULL;
+	}
+
+	slab->next   = NULL;
+	slab->length = 0;
+	return slab;
+}
+
+/**
+ * Returns a slab to the calling thread's cache. Slabs may be freed by a different thread than allocated them
+ * @param slab
+ */
+static inline void
+slab_free(struct slab *slab)
+{
+	assert(slab != NULL);
+
+	if (unlikely(slab_pool.count >= SLAB_POOL_CAPACITY)) {
+		free(slab);
+		return;
+	}
+
+	slab->next     = slab_pool.head;
+	slab_pool.head = slab;
+	slab_pool.count++;
+}
+
+static inline void
+slab_buffer_init(struct slab_buffer *self)
+{
+	self->head = NULL;
+	self->tail = NULL;
+	self->size = 0;
+}
+
+/**
+ * Returns all slabs to the calling thread's cache, leaving an empty buffer ready for reuse
+ * @param self
+ */
+static inline void
+slab_buffer_deinit(struct slab_buffer *self)
+{
+	struct slab *slab = self->head;
+	while (slab != NULL) {
+		struct slab *next = slab->next;
+		slab_free(slab);
+		slab = next;
+	}
+
+	slab_buffer_init(self);
+}
+
+/**
+ * Appends an empty slab to the chain
+ * @returns the new tail or NULL on allocation failure
+ */
+static inline struct slab *
+slab_buffer_extend(struct slab_buffer *self)
+{
+	struct slab *slab = slab_alloc();
+	if (unlikely(slab == NULL)) return NULL;
+
+	if (self->tail == NULL) {
+		self->head = slab;
+	} else {
+		self->tail->next = slab;
+	}
+	self->tail = slab;
+
+	return slab;
+}
+
+/**
+ * Appends bytes to the buffer
+ * @param self
+ * @param source
+ * @param length
+ * @returns 0 on success, -1 on allocation failure
+ */
+static inline int
+slab_buffer_write(struct slab_buffer *self, const void *source, size_t length)
+{
+	const char *cursor = source;
+
+	while (length > 0) {
+		struct slab *tail = self->tail;
+		if (tail == NULL || tail->length == SLAB_DATA_CAPACITY) {
+			tail = slab_buffer_extend(self);
+			if (unlikely(tail == NULL)) return -1;
+		}
+
+		size_t chunk = SLAB_DATA_CAPACITY - tail->length;
+		if (chunk > length) chunk = length;
+
+		memcpy(&tail->data[tail->length], cursor, chunk);
+		tail->length += chunk;
+		self->size += chunk;
+		cursor += chunk;
+		length -= chunk;
+	}
+
+	return 0;
+}
+
+/**
+ * Appends formatted text to the buffer
+ * @returns 0 on success, -1 on error
+ */
+static inline int
+slab_buffer_printf(struct slab_buffer *self, const char *format, ...)
+{
+	char    text[256];
+	va_list args;
+
+	va_start(args, format);
+	int length = vsnprintf(text, sizeof(text), format, args);
+	va_end(args);
+
+	if (unlikely(length < 0 || length >= (int)sizeof(text))) return -1;
+
+	return slab_buffer_write(self, text, (size_t)length);
+}
+
+/**
+ * Describes the bytes of the buffer starting at an offset as an iovec array
+ * @param self
+ * @param offset number of leading bytes to skip, such as those already sent
+ * @param iov array to fill
+ * @param iov_capacity size of iov
+ * @returns number of iovec entries filled
+ */
+static inline int
+slab_buffer_export_iovec(struct slab_buffer *self, size_t offset, struct iovec *iov, int iov_capacity)
+{
+	int count = 0;
+
+	for (struct slab *slab = self->head; slab != NULL && count < iov_capacity; slab = slab->next) {
+		if (offset >= slab->length) {
+			offset -= slab->length;
+			continue;
+		}
+
+		iov[count].iov_base = &slab->data[offset];
+		iov[count].iov_len  = slab->length - offset;
+		offset              = 0;
+		count++;
+	}
+
+	return count;
+}
+
+/**
+ * Copies bytes out of the buffer into contiguous memory
+ * @param self
+ * @param destination
+ * @param length maximum number of bytes to copy
+ * @returns number of bytes copied
+ */
+static inline size_t
+slab_buffer_copy_out(struct slab_buffer *self, char *destination, size_t length)
+{
+	size_t copied = 0;
+
+	for (struct slab *slab = self->head; slab != NULL && copied < length; slab = slab->next) {
+		size_t chunk = slab->length;
+		if (chunk > length - copied) chunk = length - copied;
+
+		memcpy(&destination[copied], slab->data, chunk);
+		copied += chunk;
+	}
+
+	return copied;
+}
@@ -92,7 +92,14 @@ software_interrupt_deferred_sigalrm_replay()
  * Exports from software_interrupt.c *
  ************************/
 
+extern _Atomic bool     *software_interrupt_timer_disarmed;
+extern _Atomic uint64_t *software_interrupt_arrival_deadline;
+
 void software_interrupt_arm_timer(void);
 void software_interrupt_cleanup(void);
 void software_interrupt_disarm_timer(void);
 void software_interrupt_initialize(void);
+void software_interrupt_initialize_altstack(void);
+void software_interrupt_kick(int worker_idx);
+void software_interrupt_preempt_for_arrival(uint64_t absolute_deadline, int numa_node);
+void software_interrupt_set_timer(uint32_t quantum_us);
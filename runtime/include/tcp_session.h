@@ -6,6 +6,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <threads.h>
 #include <unistd.h>
 
@@ -100,6 +101,33 @@ tcp_session_send(int client_socket, const char *buffer, size_t buffer_len, void_
 	return sent;
 }
 
+/**
+ * Writes an iovec array to the client socket with a single writev
+ * @param client_socket - the client
+ * @param iov - buffers to write to socket
+ * @param iovcnt - number of entries in iov
+ * @param on_eagain - cb to execute when client socket returns EAGAIN. If NULL, error out
+ * @returns nwritten on success, -errno, -EAGAIN on block
+ */
+static inline ssize_t
+tcp_session_sendv(int client_socket, const struct iovec *iov, int iovcnt, void_star_cb on_eagain, void *dataptr)
+{
+	assert(iov != NULL);
+	assert(iovcnt > 0);
+
+	ssize_t sent = writev(client_socket, iov, iovcnt);
+	if (sent < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			if (on_eagain != NULL) on_eagain(dataptr);
+			return -EAGAIN;
+		} else {
+			return -errno;
+		}
+	}
+
+	return sent;
+}
+
 /**
  * Writes buffer to the client socket
  * @param client_socket - the client
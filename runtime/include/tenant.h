@@ -35,7 +35,7 @@ struct tenant_global_request_queue {
 struct tenant {
 	enum epoll_tag         tag; /* Tag must be first member */
 	char                  *name;
-	struct tcp_server      tcp_server;
+	struct tcp_server     *tcp_servers; /* One SO_REUSEPORT socket per listener thread */
 	http_router_t          router;
 	struct module_database module_db;
 	struct map             scratch_storage;
@@ -91,7 +91,9 @@ tenant_alloc(struct tenant_config *config)
 	tenant->name = config->name;
 	config->name = NULL;
 
-	tcp_server_init(&tenant->tcp_server, config->port);
+	tenant->tcp_servers = calloc(runtime_listener_threads_count, sizeof(struct tcp_server));
+	if (tenant->tcp_servers == NULL) panic("Failed to allocate tcp servers for tenant %s\n", tenant->name);
+	for (int i = 0; i < runtime_listener_threads_count; i++) tcp_server_init(&tenant->tcp_servers[i], config->port);
 	http_router_init(&tenant->router, config->routes_len);
 	module_database_init(&tenant->module_db);
 	map_init(&tenant->scratch_storage);
@@ -124,6 +126,9 @@ tenant_alloc(struct tenant_config *config)
 		}
 
 		assert(module != NULL);
+		module_set_warm_instances(module, config->routes[i].warm_instances);
+		if (config->routes[i].huge_pages) module_use_huge_pages(module);
+		if (config->routes[i].stack_growable) module->growable_stacks = true;
 
 		struct module *module_proprocess = NULL;
 
@@ -152,7 +157,7 @@ tenant_alloc(struct tenant_config *config)
 		int rc = http_router_add_route(&tenant->router, &config->routes[i], module, module_proprocess);
 		if (unlikely(rc != 0)) {
 			panic("Tenant %s defined %lu routes, but router failed to grow beyond %lu\n", tenant->name,
-			      config->routes_len, tenant->router.capacity);
+			      config->routes_len, tenant->router.routes.capacity);
 		}
 
 		config->routes[i].route                  = NULL;
@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "arena.h"
+
 // TODO: Encoding this in witx.
 #define __WASI_DIRCOOKIE_START (UINT64_C(0))
 typedef uint32_t __wasi_size_t;
@@ -2211,8 +2213,7 @@ wasi_options_init(wasi_options_t *options)
 	options->envp = NULL;
 }
 
-void *wasi_context_init(wasi_options_t *options);
-void  wasi_context_destroy(wasi_context_t *handle);
+void *wasi_context_init(wasi_options_t *options, struct arena *arena);
 
 static inline __wasi_errno_t
 wasi_unsupported_syscall(const char *syscall)
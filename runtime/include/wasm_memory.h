@@ -2,11 +2,13 @@
 
 #include <assert.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
 
+#include "memfd_buffer.h"
 #include "ps_list.h"
 #include "sledge_abi.h"
 #include "types.h" /* PAGE_SIZE */
@@ -15,11 +17,19 @@
 #define WASM_MEMORY_MAX           (uint64_t) UINT32_MAX + 1
 #define WASM_MEMORY_SIZE_TO_ALLOC ((uint64_t)WASM_MEMORY_MAX + /* guard page */ PAGE_SIZE)
 
+/* Resetting a memory queries page residency this many pages at a time */
+#define WASM_MEMORY_RESIDENCY_CHUNK_PAGES 4096
+/* Runs of resident pages at least this long are returned to the kernel rather than zeroed in place */
+#define WASM_MEMORY_MADVISE_MIN_PAGES 16
+/* Size and alignment of a transparent huge page. Reservations are aligned to it so huge pages line up with them */
+#define WASM_MEMORY_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
 struct wasm_memory {
 	/* Public */
 	struct sledge_abi__wasm_memory abi;
 	/* Private */
-	struct ps_list list; /* Linked List Node used for object pool */
+	struct ps_list list;       /* Linked List Node used for object pool */
+	bool           huge_pages; /* Backed by transparent huge pages, committed a huge page at a time */
 };
 
 /* Object Lifecycle Functions */
@@ -28,6 +38,9 @@ static INLINE int32_t             wasm_memory_init(struct wasm_memory *wasm_memo
 static INLINE void                wasm_memory_deinit(struct wasm_memory *wasm_memory);
 static INLINE void                wasm_memory_free(struct wasm_memory *wasm_memory);
 static INLINE void                wasm_memory_reinit(struct wasm_memory *wasm_memory, uint64_t initial);
+static INLINE int                 wasm_memory_reinit_from_snapshot(struct wasm_memory *wasm_memory, uint64_t initial,
+                                                                   struct memfd_buffer *snapshot);
+static INLINE int                 wasm_memory_use_huge_pages(struct wasm_memory *wasm_memory);
 
 /* Memory Size */
 static INLINE int32_t  wasm_memory_expand(struct wasm_memory *wasm_memory, uint64_t size_to_expand);
@@ -87,9 +100,18 @@ wasm_memory_init(struct wasm_memory *wasm_memory, uint64_t initial, uint64_t max
 	assert(max > 0);
 	assert(max <= (size_t)UINT32_MAX + 1);
 
-	/* Allocate buffer of contiguous virtual addresses for full wasm32 linear memory and guard page */
-	wasm_memory->abi.buffer = mmap(NULL, WASM_MEMORY_SIZE_TO_ALLOC, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
-	if (wasm_memory->abi.buffer == MAP_FAILED) return -1;
+	/* Allocate buffer of contiguous virtual addresses for full wasm32 linear memory and guard page. The buffer is
+	 * aligned to a huge page, so over-reserve by one and unmap the slack on either side */
+	uint8_t *reservation = mmap(NULL, WASM_MEMORY_SIZE_TO_ALLOC + WASM_MEMORY_HUGE_PAGE_SIZE, PROT_NONE,
+	                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (reservation == MAP_FAILED) return -1;
+
+	wasm_memory->abi.buffer = (uint8_t *)round_up_to_pow2(reservation, WASM_MEMORY_HUGE_PAGE_SIZE);
+
+	size_t head = wasm_memory->abi.buffer - reservation;
+	size_t tail = WASM_MEMORY_HUGE_PAGE_SIZE - head;
+	if (head > 0) munmap(reservation, head);
+	if (tail > 0) munmap(wasm_memory->abi.buffer + WASM_MEMORY_SIZE_TO_ALLOC, tail);
 
 	/* Set the initial bytes to read / write */
 	int rc = mprotect(wasm_memory->abi.buffer, initial, PROT_READ | PROT_WRITE);
@@ -102,7 +124,34 @@ wasm_memory_init(struct wasm_memory *wasm_memory, uint64_t initial, uint64_t max
 	wasm_memory->abi.size     = initial;
 	wasm_memory->abi.capacity = initial;
 	wasm_memory->abi.max      = max;
+	wasm_memory->huge_pages   = false;
+
+	return 0;
+}
+
+/**
+ * Backs a linear memory with transparent huge pages. From here on, the memory is committed and grown a huge page at
+ * a time, so the kernel can fault in whole huge pages, and recycling zeroes the huge pages in place rather than
+ * returning them to the kernel, which would split them.
+ * @param wasm_memory a linear memory that has not run an instance yet
+ * @returns 0 on success, -1 if the kernel does not support transparent huge pages
+ */
+static INLINE int
+wasm_memory_use_huge_pages(struct wasm_memory *wasm_memory)
+{
+	assert(wasm_memory != NULL);
+	assert(!wasm_memory->huge_pages);
+
+	if (madvise(wasm_memory->abi.buffer, WASM_MEMORY_MAX, MADV_HUGEPAGE) != 0) return -1;
+
+	uint64_t capacity = round_up_to_pow2(wasm_memory->abi.capacity, WASM_MEMORY_HUGE_PAGE_SIZE);
+	if (capacity > wasm_memory->abi.max) capacity = wasm_memory->abi.max;
+	if (capacity > wasm_memory->abi.capacity
+	    && mprotect(wasm_memory->abi.buffer, capacity, PROT_READ | PROT_WRITE) != 0)
+		return -1;
 
+	wasm_memory->abi.capacity = capacity;
+	wasm_memory->huge_pages   = true;
 	return 0;
 }
 
@@ -127,13 +176,104 @@ wasm_memory_free(struct wasm_memory *wasm_memory)
 	free(wasm_memory);
 }
 
+/**
+ * Zeroes a run of resident pages, either in place or by returning them to the kernel so they fault back in as zeros
+ */
+static INLINE void
+wasm_memory_zero_pages(uint8_t *pages, size_t page_count, bool release)
+{
+	if (release && page_count >= WASM_MEMORY_MADVISE_MIN_PAGES
+	    && madvise(pages, page_count * PAGE_SIZE, MADV_DONTNEED) == 0)
+		return;
+
+	memset(pages, 0, page_count * PAGE_SIZE);
+}
+
+/**
+ * Zeroes a run of pages that are not resident. They may have been swapped out rather than never faulted in, so they
+ * are returned to the kernel, which drops any swap entries and is cheap for pages that were never touched
+ */
+static INLINE void
+wasm_memory_drop_pages(uint8_t *pages, size_t page_count)
+{
+	if (madvise(pages, page_count * PAGE_SIZE, MADV_DONTNEED) != 0) memset(pages, 0, page_count * PAGE_SIZE);
+}
+
+/**
+ * Zeroes the first size bytes of a linear memory. The resident pages reported by mincore are zeroed, and the other
+ * pages, which mincore also reports for pages swapped out under memory pressure, are returned to the kernel. A
+ * sandbox that touched a few pages of a large memory only pays for those pages, and the untouched ones are not
+ * faulted in by the reset.
+ * @param wasm_memory
+ * @param size bytes to zero, a multiple of PAGE_SIZE
+ */
+static INLINE void
+wasm_memory_zero_resident(struct wasm_memory *wasm_memory, uint64_t size)
+{
+	assert(size % PAGE_SIZE == 0);
+
+	unsigned char residency[WASM_MEMORY_RESIDENCY_CHUNK_PAGES];
+
+	for (uint64_t chunk = 0; chunk < size; chunk += (uint64_t)WASM_MEMORY_RESIDENCY_CHUNK_PAGES * PAGE_SIZE) {
+		uint8_t *chunk_start = &wasm_memory->abi.buffer[chunk];
+		size_t   page_count  = (size - chunk) / PAGE_SIZE;
+		if (page_count > WASM_MEMORY_RESIDENCY_CHUNK_PAGES) page_count = WASM_MEMORY_RESIDENCY_CHUNK_PAGES;
+
+		if (unlikely(mincore(chunk_start, page_count * PAGE_SIZE, residency) != 0)) {
+			memset(chunk_start, 0, page_count * PAGE_SIZE);
+			continue;
+		}
+
+		/* Zero each run of consecutive pages with the same residency at once */
+		size_t run_start = 0;
+		for (size_t page = 1; page <= page_count; page++) {
+			bool resident = residency[run_start] & 1;
+			if (page < page_count && (residency[page] & 1) == resident) continue;
+
+			uint8_t *run       = &chunk_start[run_start * PAGE_SIZE];
+			size_t   run_pages = page - run_start;
+			if (resident) {
+				wasm_memory_zero_pages(run, run_pages, !wasm_memory->huge_pages);
+			} else {
+				wasm_memory_drop_pages(run, run_pages);
+			}
+			run_start = page;
+		}
+	}
+}
+
 static INLINE void
 wasm_memory_reinit(struct wasm_memory *wasm_memory, uint64_t initial)
 {
-	memset(wasm_memory->abi.buffer, 0, wasm_memory->abi.size);
+	wasm_memory_zero_resident(wasm_memory, wasm_memory->abi.size);
 	wasm_memory->abi.size = initial;
 }
 
+/**
+ * Resets a linear memory to a snapshot of its initial contents without touching every byte. Mapping the snapshot
+ * again drops the pages the last instance wrote to, and pages the memory grew into past the snapshot are returned
+ * to the kernel, so they read as zeros when next faulted in.
+ * @param wasm_memory
+ * @param initial size of the memory after the reset. The snapshot covers exactly these bytes
+ * @param snapshot memfd_buffer holding the initialized memory
+ * @returns 0 on success, -1 on error
+ */
+static INLINE int
+wasm_memory_reinit_from_snapshot(struct wasm_memory *wasm_memory, uint64_t initial, struct memfd_buffer *snapshot)
+{
+	assert(snapshot->capacity == initial);
+	assert(wasm_memory->abi.capacity >= initial);
+
+	if (memfd_buffer_map_private(snapshot, wasm_memory->abi.buffer) < 0) return -1;
+
+	if (wasm_memory->abi.capacity > initial
+	    && madvise(&wasm_memory->abi.buffer[initial], wasm_memory->abi.capacity - initial, MADV_DONTNEED) != 0)
+		return -1;
+
+	wasm_memory->abi.size = initial;
+	return 0;
+}
+
 static INLINE int32_t
 wasm_memory_expand(struct wasm_memory *wasm_memory, uint64_t size_to_expand)
 {
@@ -150,13 +290,20 @@ wasm_memory_expand(struct wasm_memory *wasm_memory, uint64_t size_to_expand)
 	 * need to actually issue an mprotect syscall. The goal of these optimizations is to reduce mmap and demand
 	 * paging overhead for repeated instantiations of a WebAssembly module. */
 	if (target_size > wasm_memory->abi.capacity) {
-		int rc = mprotect(wasm_memory->abi.buffer, target_size, PROT_READ | PROT_WRITE);
+		/* Huge page memories commit whole huge pages, so the end of the memory can be backed by one too */
+		uint64_t capacity = target_size;
+		if (wasm_memory->huge_pages) {
+			capacity = round_up_to_pow2(target_size, WASM_MEMORY_HUGE_PAGE_SIZE);
+			if (capacity > wasm_memory->abi.max) capacity = wasm_memory->abi.max;
+		}
+
+		int rc = mprotect(wasm_memory->abi.buffer, capacity, PROT_READ | PROT_WRITE);
 		if (rc != 0) {
 			perror("wasm_memory_expand mprotect");
 			return -1;
 		}
 
-		wasm_memory->abi.capacity = target_size;
+		wasm_memory->abi.capacity = capacity;
 	}
 
 	wasm_memory->abi.size = target_size;
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -9,6 +10,12 @@
 #include "ps_list.h"
 #include "types.h"
 
+/* Bytes of stack a growable stack commits at a time */
+#define WASM_STACK_GROWTH_STEP (16 * PAGE_SIZE)
+
+/* Pages of the used stack nearest high that a reset zeroes in place. Deeper pages are returned to the kernel */
+#define WASM_STACK_ZERO_IN_PLACE_PAGES 16
+
 /**
  * @brief wasm_stack is a stack used to execute an AOT-compiled WebAssembly instance. It is allocated with a static size
  * and a guard page beneath the lowest usuable address. Because the stack grows down, this protects against stack
@@ -16,35 +23,41 @@
  *
  * Low Address  <---------------------------------------------------------------------------> High Address
  *              | GUARD PAGE    | USEABE FOR STACK FRAMES (SIZE of capacity)                |
- *             /\              /\                                                          /\
- *            buffer           low                                                        high
+ *             /\              /\                       /\                                 /\
+ *            buffer           low                    committed                          high
  *
  *                                                            | Frame 2 | Frame 1 | Frame 0 |
  *                                                          <<<<<<< Direction of Stack Growth
+ *
+ * A growable stack reserves the full capacity but only makes [committed, high) read / write. The rest stays
+ * inaccessible until a fault below committed grows it, so the guard page still catches overflows. A static stack
+ * commits its whole capacity up front, so committed == low.
  */
 struct wasm_stack {
-	struct ps_list list;     /* Linked List Node used for object pool */
-	uint64_t       capacity; /* Usable capacity. Excludes size of guard page that we need to free */
-	uint8_t       *high;     /* The highest address of the stack. Grows down from here */
-	uint8_t       *low;      /* The address of the lowest useabe address. Above guard page */
-	uint8_t       *buffer;   /* Points base address of backing heap allocation (Guard Page) */
+	struct ps_list list;      /* Linked List Node used for object pool */
+	uint64_t       capacity;  /* Usable capacity. Excludes size of guard page that we need to free */
+	uint8_t       *high;      /* The highest address of the stack. Grows down from here */
+	uint8_t       *low;       /* The address of the lowest useabe address. Above guard page */
+	uint8_t       *committed; /* The lowest read / write address. Equal to low unless the stack is growable */
+	uint8_t       *buffer;    /* Points base address of backing heap allocation (Guard Page) */
 };
 
-static struct wasm_stack *wasm_stack_alloc(uint64_t capacity);
-static inline int         wasm_stack_init(struct wasm_stack *wasm_stack, uint64_t capacity);
+static struct wasm_stack *wasm_stack_alloc(uint64_t capacity, bool growable);
+static inline int         wasm_stack_init(struct wasm_stack *wasm_stack, uint64_t capacity, bool growable);
 static inline void        wasm_stack_reinit(struct wasm_stack *wasm_stack);
 static inline void        wasm_stack_deinit(struct wasm_stack *wasm_stack);
 static inline void        wasm_stack_free(struct wasm_stack *wasm_stack);
 
 /**
- * Allocates a static sized stack for a sandbox with a guard page underneath
+ * Allocates a stack for a sandbox with a guard page underneath
  * Because a stack grows down, this protects against stack overflow
- * TODO: Should this use MAP_GROWSDOWN to enable demand paging for the stack?
- * @param sandbox sandbox that we want to allocate a stack for
+ * @param wasm_stack
+ * @param capacity usable bytes, a multiple of PAGE_SIZE
+ * @param growable commit only the top WASM_STACK_GROWTH_STEP bytes and grow on demand with wasm_stack_grow
  * @returns 0 on success, -1 on error
  */
 static inline int
-wasm_stack_init(struct wasm_stack *wasm_stack, uint64_t capacity)
+wasm_stack_init(struct wasm_stack *wasm_stack, uint64_t capacity, bool growable)
 {
 	assert(wasm_stack);
 
@@ -57,12 +70,16 @@ wasm_stack_init(struct wasm_stack *wasm_stack, uint64_t capacity)
 		goto err_stack_allocation_failed;
 	}
 
-	wasm_stack->low      = wasm_stack->buffer + /* guard page */ PAGE_SIZE;
-	wasm_stack->capacity = capacity;
-	wasm_stack->high     = wasm_stack->low + capacity;
+	wasm_stack->low       = wasm_stack->buffer + /* guard page */ PAGE_SIZE;
+	wasm_stack->capacity  = capacity;
+	wasm_stack->high      = wasm_stack->low + capacity;
+	wasm_stack->committed = wasm_stack->low;
+	if (growable && capacity > WASM_STACK_GROWTH_STEP) {
+		wasm_stack->committed = wasm_stack->high - WASM_STACK_GROWTH_STEP;
+	}
 
 	/* Set the initial bytes to read / write */
-	rc = mprotect(wasm_stack->low, capacity, PROT_READ | PROT_WRITE);
+	rc = mprotect(wasm_stack->committed, wasm_stack->high - wasm_stack->committed, PROT_READ | PROT_WRITE);
 	if (unlikely(rc != 0)) {
 		perror("sandbox set stack read/write");
 		goto err_stack_prot_failed;
@@ -83,10 +100,10 @@ err_stack_allocation_failed:
 }
 
 static struct wasm_stack *
-wasm_stack_alloc(uint64_t capacity)
+wasm_stack_alloc(uint64_t capacity, bool growable)
 {
 	struct wasm_stack *wasm_stack = calloc(1, sizeof(struct wasm_stack));
-	int                rc         = wasm_stack_init(wasm_stack, capacity);
+	int                rc         = wasm_stack_init(wasm_stack, capacity, growable);
 	if (rc < 0) {
 		wasm_stack_free(wasm_stack);
 		return NULL;
@@ -103,9 +120,10 @@ wasm_stack_deinit(struct wasm_stack *wasm_stack)
 
 	/* The stack start is the bottom of the usable stack, but we allocated a guard page below this */
 	munmap(wasm_stack->buffer, wasm_stack->capacity + PAGE_SIZE);
-	wasm_stack->buffer = NULL;
-	wasm_stack->high   = NULL;
-	wasm_stack->low    = NULL;
+	wasm_stack->buffer    = NULL;
+	wasm_stack->high      = NULL;
+	wasm_stack->low       = NULL;
+	wasm_stack->committed = NULL;
 }
 
 static inline void
@@ -117,6 +135,46 @@ wasm_stack_free(struct wasm_stack *wasm_stack)
 	free(wasm_stack);
 }
 
+/**
+ * Commits more of a growable stack so that addr becomes writable. Called from the SIGSEGV handler, so it only
+ * makes async-signal-safe calls
+ * @param wasm_stack
+ * @param addr the faulting address
+ * @returns true if addr was in the uncommitted part of the stack and is now writable
+ */
+static inline bool
+wasm_stack_grow(struct wasm_stack *wasm_stack, void *addr)
+{
+	uint8_t *fault = (uint8_t *)addr;
+	if (fault < wasm_stack->low || fault >= wasm_stack->committed) return false;
+
+	/* Grow in whole steps below the fault, so a deep call does not fault once per page */
+	uint64_t distance  = (uint64_t)(wasm_stack->committed - fault);
+	uint64_t grow_size = (distance + WASM_STACK_GROWTH_STEP - 1) / WASM_STACK_GROWTH_STEP * WASM_STACK_GROWTH_STEP;
+	if (grow_size > (uint64_t)(wasm_stack->committed - wasm_stack->low))
+		grow_size = (uint64_t)(wasm_stack->committed - wasm_stack->low);
+
+	if (mprotect(wasm_stack->committed - grow_size, grow_size, PROT_READ | PROT_WRITE) != 0) return false;
+
+	wasm_stack->committed -= grow_size;
+	return true;
+}
+
+/**
+ * @returns true if addr is in the guard page beneath the stack
+ */
+static inline bool
+wasm_stack_is_guard_page(struct wasm_stack *wasm_stack, void *addr)
+{
+	return (uint8_t *)addr >= wasm_stack->buffer && (uint8_t *)addr < wasm_stack->low;
+}
+
+/**
+ * Resets a stack for reuse. The top WASM_STACK_ZERO_IN_PLACE_PAGES of the committed stack are zeroed in place
+ * because the next execution is likely to use them again. Everything deeper is returned to the kernel so that it
+ * faults back in as zeros only if used again. Residency is not consulted, as pages swapped out under memory pressure
+ * read as non-resident but would fault back in with their old contents, and releasing untouched pages is cheap.
+ */
 static inline void
 wasm_stack_reinit(struct wasm_stack *wasm_stack)
 {
@@ -125,6 +183,13 @@ wasm_stack_reinit(struct wasm_stack *wasm_stack)
 	assert(wasm_stack->low == wasm_stack->buffer + /* guard page */ PAGE_SIZE);
 	assert(wasm_stack->high == wasm_stack->low + wasm_stack->capacity);
 
-	explicit_bzero(wasm_stack->low, wasm_stack->capacity);
+	uint8_t *in_place = wasm_stack->high - WASM_STACK_ZERO_IN_PLACE_PAGES * PAGE_SIZE;
+	if (in_place < wasm_stack->committed) in_place = wasm_stack->committed;
+
+	if (wasm_stack->committed < in_place
+	    && madvise(wasm_stack->committed, in_place - wasm_stack->committed, MADV_DONTNEED) != 0)
+		explicit_bzero(wasm_stack->committed, in_place - wasm_stack->committed);
+	explicit_bzero(in_place, wasm_stack->high - in_place);
+
 	ps_list_init_d(wasm_stack);
 }
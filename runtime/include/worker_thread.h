@@ -8,3 +8,4 @@ extern thread_local struct arch_context worker_thread_base_context;
 extern thread_local int                 worker_thread_idx;
 
 void *worker_thread_main(void *return_code);
+void  worker_thread_trim_pools(void);
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <assert.h>
+#include <stdatomic.h>
+
+#include "likely.h"
+#include "runtime.h"
+#include "sandbox_set_as_runnable.h"
+#include "sandbox_types.h"
+#include "software_interrupt.h"
+#include "types.h"
+#include "worker_thread.h"
+
+/*
+ * Only runnable sandboxes that have not started move between workers, so a sleeping sandbox wakes on the worker it
+ * slept on. Only that worker adds to its runqueue, so a thread that wants to wake a sleeping sandbox cannot add it to
+ * a runqueue itself. Instead, it pushes the sandbox onto the wakeup queue of the worker it sleeps on, and that worker
+ * makes it runnable the next time it schedules.
+ *
+ * Each queue is a lock-free stack linked through sandbox->wakeup_next. Any thread may push, and only the owning
+ * worker pops, taking the whole stack at once.
+ */
+struct worker_wakeup_queue {
+	_Atomic(struct sandbox *) head;
+} CACHE_PAD_ALIGNED;
+
+/* Array of runtime_worker_threads_count queues, indexed by worker_thread_idx */
+extern struct worker_wakeup_queue *worker_wakeup_queues;
+
+void worker_wakeup_queue_initialize(void);
+
+/**
+ * Hands an asleep sandbox back to the worker it sleeps on. Safe to call from any thread.
+ * @param worker_idx worker_thread_idx of the worker the sandbox slept on
+ * @param sandbox a sandbox in the SANDBOX_ASLEEP state
+ */
+static inline void
+worker_wakeup_queue_push(int worker_idx, struct sandbox *sandbox)
+{
+	assert(worker_idx >= 0 && worker_idx < runtime_worker_threads_count);
+	assert(sandbox->state == SANDBOX_ASLEEP);
+
+	struct worker_wakeup_queue *queue = &worker_wakeup_queues[worker_idx];
+	struct sandbox             *head  = atomic_load_explicit(&queue->head, memory_order_relaxed);
+
+	do {
+		sandbox->wakeup_next = head;
+	} while (!atomic_compare_exchange_weak_explicit(&queue->head, &head, sandbox, memory_order_release,
+	                                                memory_order_relaxed));
+
+	/* A tickless worker may not enter its scheduler until its sandbox finishes */
+	software_interrupt_kick(worker_idx);
+}
+
+/**
+ * @returns true if nothing was pushed to the executing worker's queue since it was last drained
+ */
+static inline bool
+worker_wakeup_queue_is_empty(void)
+{
+	atomic_thread_fence(memory_order_seq_cst);
+	return atomic_load_explicit(&worker_wakeup_queues[worker_thread_idx].head, memory_order_seq_cst) == NULL;
+}
+
+/**
+ * Makes every sandbox pushed to the executing worker's queue runnable. Called by the scheduler before it picks
+ * the next sandbox.
+ */
+static inline void
+worker_wakeup_queue_drain(void)
+{
+	struct worker_wakeup_queue *queue = &worker_wakeup_queues[worker_thread_idx];
+
+	/* Skip the atomic exchange in the common case where nothing was woken up */
+	if (likely(atomic_load_explicit(&queue->head, memory_order_relaxed) == NULL)) return;
+
+	struct sandbox *sandbox = atomic_exchange_explicit(&queue->head, NULL, memory_order_acquire);
+	while (sandbox != NULL) {
+		struct sandbox *next = sandbox->wakeup_next;
+		sandbox->wakeup_next = NULL;
+		sandbox_wakeup(sandbox);
+		sandbox = next;
+	}
+}
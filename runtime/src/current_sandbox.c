@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <setjmp.h>
 #include <threads.h>
 
@@ -39,6 +40,102 @@ current_sandbox_sleep()
 	scheduler_cooperative_sched(false);
 }
 
+/**
+ * @brief Blocks the current sandbox until more of a streaming request body has arrived
+ *
+ * Sandboxes of routes that stream their request body are dispatched before the whole body has been received. The
+ * sandbox sleeps until the listener publishes more than offset bytes or the end of the body, and then wakes it up.
+ * Other requests are complete before their sandbox is dispatched, so this returns immediately.
+ * @param offset bytes of the body the sandbox already consumed. INT_MAX waits for the whole body
+ * @returns bytes of the body that may be read
+ */
+int
+current_sandbox_wait_for_request_body(int offset)
+{
+	struct sandbox *sandbox = current_sandbox_get();
+	assert(sandbox != NULL);
+	assert(sandbox->state == SANDBOX_RUNNING_SYS);
+
+	struct http_session *session = sandbox->http;
+	if (!session->request_body_streaming) return session->http_request.body_length;
+
+	while (true) {
+		lock_node_t node = {};
+		lock_lock(&session->request_body_lock, &node);
+
+		int available = session->request_body_available;
+		if (available > offset || session->request_body_complete) {
+			lock_unlock(&session->request_body_lock, &node);
+			return available;
+		}
+
+		/* Fall asleep before releasing the lock, so the listener can only wake a sandbox that is asleep */
+		session->request_body_waiter        = sandbox;
+		session->request_body_waiter_worker = worker_thread_idx;
+		sandbox_sleep(sandbox);
+		lock_unlock(&session->request_body_lock, &node);
+
+		scheduler_cooperative_sched(false);
+	}
+}
+
+/**
+ * @brief Sends the output buffered so far by a sandbox of a route that streams its response as one chunk
+ *
+ * The first chunk is preceded by a header announcing chunked transfer encoding. If the socket would block, the
+ * sandbox registers the session for EPOLLOUT and sleeps until the listener sees the socket writable, so a slow
+ * client throttles the sandbox instead of letting its output pile up.
+ * @returns 0 on success, -1 if the client can no longer be written to
+ */
+int
+current_sandbox_send_response_chunk(void)
+{
+	struct sandbox *sandbox = current_sandbox_get();
+	assert(sandbox != NULL);
+	assert(sandbox->state == SANDBOX_RUNNING_SYS);
+	assert(sandbox->route->stream_response);
+
+	struct http_session *session = sandbox->http;
+
+	if (!session->response_streaming) {
+		/* The listener owns the session of a streaming request until the whole body has been received */
+		current_sandbox_wait_for_request_body(INT_MAX);
+
+		session->response_streaming = true;
+		http_session_set_response_header(session, 200);
+	}
+
+	if (unlikely(http_session_frame_response_chunk(session, false) < 0)) goto err;
+
+	session->state = HTTP_SESSION_STREAMING_RESPONSE;
+	while (true) {
+		int rc = http_session_send_response_buffers(session, NULL);
+		if (rc == 0) break;
+		if (rc != -EAGAIN) goto err;
+
+		/* Fall asleep before registering, so the listener can only wake a sandbox that is asleep */
+		session->state                  = HTTP_SESSION_STREAMING_RESPONSE;
+		session->response_waiter        = sandbox;
+		session->response_waiter_worker = worker_thread_idx;
+		sandbox_sleep(sandbox);
+		listener_thread_register_http_session(session);
+
+		scheduler_cooperative_sched(false);
+		assert(session->state == HTTP_SESSION_STREAMING_RESPONSE);
+	}
+
+	http_session_release_response_chunk(session);
+	session->state = HTTP_SESSION_EXECUTING;
+	return 0;
+
+err:
+	/* Drop the output, and close the connection once the sandbox completes */
+	http_session_release_response_chunk(session);
+	session->keep_alive = false;
+	session->state      = HTTP_SESSION_EXECUTING;
+	return -1;
+}
+
 /**
  * @brief Switches from an executing sandbox to the worker thread base context
  *
@@ -55,6 +152,8 @@ current_sandbox_exit()
 		sandbox_exit_success(exiting_sandbox);
 		break;
 	case SANDBOX_RUNNING_SYS:
+		/* The listener owns the session of a streaming request until the whole body has been received */
+		current_sandbox_wait_for_request_body(INT_MAX);
 		sandbox_exit_error(exiting_sandbox);
 		break;
 	default:
@@ -131,7 +230,7 @@ current_sandbox_init()
 
 	options.argc                                          = sandbox->http->http_request.query_params_count + 1;
 	options.argv                                          = (const char **)&args;
-	sandbox->wasi_context                                 = wasi_context_init(&options);
+	sandbox->wasi_context                                 = wasi_context_init(&options, &sandbox->arena);
 	sledge_abi__current_wasm_module_instance.wasi_context = sandbox->wasi_context;
 	assert(sandbox->wasi_context != NULL);
 
@@ -163,6 +262,8 @@ current_sandbox_fini()
 	assert(sandbox->state == SANDBOX_RUNNING_SYS);
 
 done:
+	/* The listener owns the session of a streaming request until the whole body has been received */
+	current_sandbox_wait_for_request_body(INT_MAX);
 	sandbox_set_as_returned(sandbox, SANDBOX_RUNNING_SYS);
 
 	/* Cleanup connection and exit sandbox */
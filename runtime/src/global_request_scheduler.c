@@ -22,6 +22,7 @@ uninitialized_peek()
 	panic("Global Request Scheduler Peek was called before initialization\n");
 }
 
+thread_local int global_request_scheduler_last_node = 0;
 
 /* The global of our polymorphic interface */
 static struct global_request_scheduler_config global_request_scheduler = {.add_fn    = uninitialized_add,
@@ -1,18 +1,53 @@
+#include <limits.h>
+
 #include "global_request_scheduler_deque.h"
 #include "global_request_scheduler.h"
+#include "listener_thread.h"
+#include "lock.h"
+#include "numa_topology.h"
 #include "runtime.h"
 
 #define GLOBAL_REQUEST_SCHEDULER_DEQUE_CAPACITY (1 << 12)
 
-static struct deque_sandbox *global_request_scheduler_deque;
+/* One deque per NUMA node, each with its own push lock. Workers steal from the deques of other nodes only when the
+ * deque of their own node is empty */
+static struct deque_sandbox *global_request_scheduler_deques;
+static lock_t               *global_request_scheduler_deque_push_locks;
+
+/**
+ * Picks the node to queue a request on: the node with workers that has the fewest queued requests, preferring the
+ * node of the calling listener on a tie. The indices are read without synchronization, so this is only a hint
+ * @returns node
+ */
+static inline int
+global_request_scheduler_deque_pick_node(void)
+{
+	if (numa_topology_node_count == 1) return 0;
+
+	int  best_node = numa_topology_local_node;
+	long best_size = LONG_MAX;
+	for (int i = 0; i < numa_topology_node_count; i++) {
+		int node = (numa_topology_local_node + i) % numa_topology_node_count;
+		if (numa_topology_node_worker_count[node] == 0) continue;
+
+		struct deque_sandbox *deque = &global_request_scheduler_deques[node];
+		long                  size  = deque->bottom - deque->top;
+		if (size < best_size) {
+			best_node = node;
+			best_size = size;
+		}
+	}
+
+	return best_node;
+}
 
 /**
  * Pushes a sandbox to the global deque.
  *
- * No lock is required: this is a work-stealing deque used as a single-producer / multi-consumer queue. Only the
- * listener thread ever pushes (the "owner" end), while worker threads only ever steal (the lock-free opposite
- * end, coordinated by a CAS). The owner's other operation, deque_pop, is never used, so the multi-owner case the
- * deque comments warn about does not arise here.
+ * This is a work-stealing deque used as a multi-producer / multi-consumer queue. Listener threads push to the
+ * "owner" end, while worker threads only ever steal from the lock-free opposite end, coordinated by a CAS. The
+ * deque only supports a single owner, so pushes are serialized by a lock when there are several listener threads.
+ * The owner's other operation, deque_pop, is never used.
  *
  * @param sandbox
  * @returns pointer to sandbox if added. NULL otherwise
@@ -20,11 +55,22 @@ static struct deque_sandbox *global_request_scheduler_deque;
 static struct sandbox *
 global_request_scheduler_deque_add(struct sandbox *sandbox)
 {
+	assert(listener_thread_is_running());
+
 	int return_code = 1;
+	int numa_node   = global_request_scheduler_deque_pick_node();
 
-	return_code = deque_push_sandbox(global_request_scheduler_deque, &sandbox);
+	if (runtime_listener_threads_count == 1) {
+		return_code = deque_push_sandbox(&global_request_scheduler_deques[numa_node], &sandbox);
+	} else {
+		lock_node_t node = {};
+		lock_lock(&global_request_scheduler_deque_push_locks[numa_node], &node);
+		return_code = deque_push_sandbox(&global_request_scheduler_deques[numa_node], &sandbox);
+		lock_unlock(&global_request_scheduler_deque_push_locks[numa_node], &node);
+	}
 
 	if (return_code != 0) return NULL;
+	global_request_scheduler_last_node = numa_node;
 	return sandbox;
 }
 
@@ -40,7 +86,18 @@ global_request_scheduler_deque_add(struct sandbox *sandbox)
 static int
 global_request_scheduler_deque_remove(struct sandbox **removed_sandbox)
 {
-	return deque_steal_sandbox(global_request_scheduler_deque, removed_sandbox);
+	int return_code = deque_steal_sandbox(&global_request_scheduler_deques[numa_topology_local_node],
+	                                      removed_sandbox);
+	if (return_code != -ENOENT) return return_code;
+
+	/* The node has no queued requests, so steal from the other nodes */
+	for (int i = 1; i < numa_topology_node_count; i++) {
+		int node    = (numa_topology_local_node + i) % numa_topology_node_count;
+		return_code = deque_steal_sandbox(&global_request_scheduler_deques[node], removed_sandbox);
+		if (return_code != -ENOENT) return return_code;
+	}
+
+	return -ENOENT;
 }
 
 static int
@@ -53,12 +110,19 @@ global_request_scheduler_deque_remove_if_earlier(struct sandbox **removed_sandbo
 void
 global_request_scheduler_deque_initialize()
 {
-	/* Allocate and Initialize the global deque */
-	global_request_scheduler_deque = (struct deque_sandbox *)calloc(1, sizeof(struct deque_sandbox));
-	assert(global_request_scheduler_deque);
-	/* Note: Below is a Macro. It heap-allocates the backing buffer sized to the requested capacity. */
-	int rc = deque_init_sandbox(global_request_scheduler_deque, GLOBAL_REQUEST_SCHEDULER_DEQUE_CAPACITY);
-	if (rc != 0) panic("Failed to allocate global request scheduler deque\n");
+	/* Allocate and Initialize the global deques */
+	global_request_scheduler_deques = (struct deque_sandbox *)calloc(numa_topology_node_count,
+	                                                                  sizeof(struct deque_sandbox));
+	assert(global_request_scheduler_deques);
+	global_request_scheduler_deque_push_locks = (lock_t *)calloc(numa_topology_node_count, sizeof(lock_t));
+	assert(global_request_scheduler_deque_push_locks);
+	for (int node = 0; node < numa_topology_node_count; node++) {
+		/* Note: Below is a Macro. It heap-allocates the backing buffer sized to the requested capacity. */
+		int rc = deque_init_sandbox(&global_request_scheduler_deques[node],
+		                            GLOBAL_REQUEST_SCHEDULER_DEQUE_CAPACITY);
+		if (rc != 0) panic("Failed to allocate global request scheduler deque\n");
+		lock_init(&global_request_scheduler_deque_push_locks[node]);
+	}
 
 	/* Register Function Pointers for Abstract Scheduling API */
 	struct global_request_scheduler_config config = {.add_fn    = global_request_scheduler_deque_add,
@@ -3,14 +3,67 @@
 
 #include "global_request_scheduler.h"
 #include "listener_thread.h"
+#include "numa_topology.h"
 #include "panic.h"
 #include "priority_queue.h"
 #include "runtime.h"
 
-static struct priority_queue *global_request_scheduler_minheap;
+/*
+ * One minheap per NUMA node. Workers take requests from the minheap of their own node, and only take from the
+ * minheaps of other nodes when theirs is empty
+ */
+static struct priority_queue **global_request_scheduler_minheaps;
+
+/**
+ * Picks the node to queue a request on: the node with workers that has the fewest queued requests, preferring the
+ * node of the calling listener on a tie. Sizes are read without the locks, so this is only a hint
+ * @returns node
+ */
+static inline int
+global_request_scheduler_minheap_pick_node(void)
+{
+	if (numa_topology_node_count == 1) return 0;
+
+	int    best_node = numa_topology_local_node;
+	size_t best_size = SIZE_MAX;
+	for (int i = 0; i < numa_topology_node_count; i++) {
+		int node = (numa_topology_local_node + i) % numa_topology_node_count;
+		if (numa_topology_node_worker_count[node] == 0) continue;
+
+		size_t size = global_request_scheduler_minheaps[node]->size;
+		if (size < best_size) {
+			best_node = node;
+			best_size = size;
+		}
+	}
+
+	return best_node;
+}
 
 /**
- * Pushes a sandbox to the global deque
+ * Finds the node whose minheap holds the highest priority request, ignoring the calling worker's own node
+ * @returns node or -1 if the other minheaps are empty
+ */
+static inline int
+global_request_scheduler_minheap_steal_node(void)
+{
+	int      victim           = -1;
+	uint64_t highest_priority = UINT64_MAX;
+	for (int node = 0; node < numa_topology_node_count; node++) {
+		if (node == numa_topology_local_node) continue;
+
+		uint64_t priority = priority_queue_peek(global_request_scheduler_minheaps[node]);
+		if (priority < highest_priority) {
+			victim           = node;
+			highest_priority = priority;
+		}
+	}
+
+	return victim;
+}
+
+/**
+ * Pushes a sandbox to the minheap of the node picked for it
  * @param sandbox
  * @returns pointer to sandbox if added. NULL otherwise
  */
@@ -18,12 +71,14 @@ static struct sandbox *
 global_request_scheduler_minheap_add(struct sandbox *sandbox)
 {
 	assert(sandbox);
-	assert(global_request_scheduler_minheap);
+	assert(global_request_scheduler_minheaps);
 	if (unlikely(!listener_thread_is_running())) panic("%s is only callable by the listener thread\n", __func__);
 
-	int return_code = priority_queue_enqueue(global_request_scheduler_minheap, sandbox);
+	int node        = global_request_scheduler_minheap_pick_node();
+	int return_code = priority_queue_enqueue(global_request_scheduler_minheaps[node], sandbox);
 
 	if (return_code != 0) return NULL;
+	global_request_scheduler_last_node = node;
 	return sandbox;
 }
 
@@ -34,7 +89,13 @@ global_request_scheduler_minheap_add(struct sandbox *sandbox)
 int
 global_request_scheduler_minheap_remove(struct sandbox **removed_sandbox)
 {
-	return priority_queue_dequeue(global_request_scheduler_minheap, (void **)removed_sandbox);
+	int return_code = priority_queue_dequeue(global_request_scheduler_minheaps[numa_topology_local_node],
+	                                         (void **)removed_sandbox);
+	if (return_code != -ENOENT || numa_topology_node_count == 1) return return_code;
+
+	int victim = global_request_scheduler_minheap_steal_node();
+	if (victim < 0) return -ENOENT;
+	return priority_queue_dequeue(global_request_scheduler_minheaps[victim], (void **)removed_sandbox);
 }
 
 /**
@@ -45,7 +106,14 @@ global_request_scheduler_minheap_remove(struct sandbox **removed_sandbox)
 int
 global_request_scheduler_minheap_remove_if_earlier(struct sandbox **removed_sandbox, uint64_t target_latest_start)
 {
-	return priority_queue_dequeue_if_earlier(global_request_scheduler_minheap, (void **)removed_sandbox,
+	struct priority_queue *local = global_request_scheduler_minheaps[numa_topology_local_node];
+	if (numa_topology_node_count == 1 || priority_queue_peek(local) != UINT64_MAX)
+		return priority_queue_dequeue_if_earlier(local, (void **)removed_sandbox, target_latest_start);
+
+	/* The node has no queued requests, so steal the highest priority request of another node */
+	int victim = global_request_scheduler_minheap_steal_node();
+	if (victim < 0) return -ENOENT;
+	return priority_queue_dequeue_if_earlier(global_request_scheduler_minheaps[victim], (void **)removed_sandbox,
 	                                         target_latest_start);
 }
 
@@ -53,12 +121,18 @@ global_request_scheduler_minheap_remove_if_earlier(struct sandbox **removed_sand
  * Peek at the priority of the highest priority task without having to take the lock
  * Because this is a min-heap PQ, the highest priority is the lowest 64-bit integer
  * This is used to store an absolute deadline
- * @returns value of highest priority value in queue or ULONG_MAX if empty
+ * @returns value of highest priority value in the minheap of the calling thread's node, or of any node if that
+ * minheap is empty. ULONG_MAX if all are empty
  */
 static uint64_t
 global_request_scheduler_minheap_peek(void)
 {
-	return priority_queue_peek(global_request_scheduler_minheap);
+	uint64_t priority = priority_queue_peek(global_request_scheduler_minheaps[numa_topology_local_node]);
+	if (priority != UINT64_MAX || numa_topology_node_count == 1) return priority;
+
+	int victim = global_request_scheduler_minheap_steal_node();
+	if (victim < 0) return UINT64_MAX;
+	return priority_queue_peek(global_request_scheduler_minheaps[victim]);
 }
 
 uint64_t
@@ -77,7 +151,11 @@ sandbox_get_priority_fn(void *element)
 void
 global_request_scheduler_minheap_initialize()
 {
-	global_request_scheduler_minheap = priority_queue_initialize(4096, true, sandbox_get_priority_fn);
+	global_request_scheduler_minheaps = calloc(numa_topology_node_count, sizeof(struct priority_queue *));
+	assert(global_request_scheduler_minheaps != NULL);
+	for (int node = 0; node < numa_topology_node_count; node++) {
+		global_request_scheduler_minheaps[node] = priority_queue_initialize(4096, true, sandbox_get_priority_fn);
+	}
 
 	struct global_request_scheduler_config config = {.add_fn    = global_request_scheduler_minheap_add,
 	                                                 .remove_fn = global_request_scheduler_minheap_remove,
@@ -91,5 +169,8 @@ global_request_scheduler_minheap_initialize()
 void
 global_request_scheduler_minheap_free()
 {
-	priority_queue_free(global_request_scheduler_minheap);
+	for (int node = 0; node < numa_topology_node_count; node++) {
+		priority_queue_free(global_request_scheduler_minheaps[node]);
+	}
+	free(global_request_scheduler_minheaps);
 }
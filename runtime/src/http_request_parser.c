@@ -0,0 +1,421 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+
+#include "arch/http_scan.h"
+#include "debuglog.h"
+#include "http.h"
+#include "http_request_parser.h"
+#include "likely.h"
+
+/* Longest chunk size or trailer line accepted in a chunked body */
+#define HTTP_REQUEST_PARSER_MAX_LINE_LENGTH 1024
+
+static const struct {
+	const char      *name;
+	size_t           length;
+	enum http_method method;
+} http_request_parser_methods[] = {
+	{ "GET", 3, HTTP_METHOD_GET },         { "POST", 4, HTTP_METHOD_POST },
+	{ "PUT", 3, HTTP_METHOD_PUT },         { "HEAD", 4, HTTP_METHOD_HEAD },
+	{ "DELETE", 6, HTTP_METHOD_DELETE },   { "OPTIONS", 7, HTTP_METHOD_OPTIONS },
+	{ "PATCH", 5, HTTP_METHOD_PATCH },     { "CONNECT", 7, HTTP_METHOD_CONNECT },
+	{ "TRACE", 5, HTTP_METHOD_TRACE },
+};
+
+static inline ssize_t
+http_request_parser_fail(struct http_request_parser *parser, const char *reason)
+{
+	parser->error = reason;
+	return -1;
+}
+
+static inline enum http_method
+http_request_parser_match_method(const char *name, size_t length)
+{
+	for (size_t i = 0; i < sizeof(http_request_parser_methods) / sizeof(http_request_parser_methods[0]); i++) {
+		if (http_request_parser_methods[i].length == length
+		    && memcmp(http_request_parser_methods[i].name, name, length) == 0)
+			return http_request_parser_methods[i].method;
+	}
+
+	return HTTP_METHOD_UNKNOWN;
+}
+
+/**
+ * @returns the end of the content of the line that ends at newline, excluding a carriage return
+ */
+static inline char *
+http_request_parser_line_end(char *line, char *newline)
+{
+	if (newline > line && newline[-1] == '\r') return newline - 1;
+	return newline;
+}
+
+/**
+ * Checks if a comma separated header value such as that of Connection contains a token, ignoring case
+ */
+static inline bool
+http_request_parser_has_token(const char *value, size_t value_length, const char *token)
+{
+	const size_t token_length = strlen(token);
+	const char  *end          = value + value_length;
+
+	while (value < end) {
+		while (value < end && (*value == ' ' || *value == '\t' || *value == ',')) value++;
+
+		const char *token_end = http_scan_either(value, end, ',', ',');
+		if (token_end == NULL) token_end = end;
+
+		const char *trimmed_end = token_end;
+		while (trimmed_end > value && (trimmed_end[-1] == ' ' || trimmed_end[-1] == '\t')) trimmed_end--;
+
+		if ((size_t)(trimmed_end - value) == token_length && strncasecmp(value, token, token_length) == 0)
+			return true;
+
+		value = token_end;
+	}
+
+	return false;
+}
+
+/**
+ * Searches the bytes received since the last call for the blank line that ends the head
+ * @returns length of the head including the blank line, or 0 if the head is not complete yet
+ */
+static inline size_t
+http_request_parser_find_head_end(struct http_request_parser *parser, const char *data, size_t length)
+{
+	const char *end    = data + length;
+	const char *cursor = data + parser->head_scanned;
+
+	while ((cursor = http_scan_either(cursor, end, '\n', '\n')) != NULL) {
+		/* A blank line is a line break directly after another, with an optional carriage return between them */
+		if ((cursor - data >= 1 && cursor[-1] == '\n')
+		    || (cursor - data >= 2 && cursor[-1] == '\r' && cursor[-2] == '\n'))
+			return (size_t)(cursor + 1 - data);
+		cursor++;
+	}
+
+	parser->head_scanned = length;
+	return 0;
+}
+
+/**
+ * Splits the query string of the request target into params, NUL-terminating each in place
+ */
+static inline void
+http_request_parser_parse_query_params(struct http_request *http_request, char *query, char *end)
+{
+	char *param = query;
+
+	while (http_request->query_params_count < HTTP_MAX_QUERY_PARAM_COUNT) {
+		char *separator = (char *)http_scan_either(param, end, '&', '&');
+		if (separator == NULL) separator = end;
+
+		*separator = '\0';
+		http_request->query_params[http_request->query_params_count].value        = param;
+		http_request->query_params[http_request->query_params_count].value_length = (int)(separator - param);
+		http_request->query_params_count++;
+
+		if (separator == end) break;
+		param = separator + 1;
+	}
+}
+
+/**
+ * Parses a complete request line and header block
+ * @param parser
+ * @param http_request
+ * @param data start of the head
+ * @param head_length length of the head including the blank line that ends it
+ * @returns 0 on success, -1 on a malformed request
+ */
+static inline int
+http_request_parser_parse_head(struct http_request_parser *parser, struct http_request *http_request, char *data,
+                               size_t head_length)
+{
+	char *const end    = data + head_length;
+	char       *cursor = data;
+
+	/* Method */
+	char *space = (char *)http_scan_either(cursor, end, ' ', '\n');
+	if (unlikely(space == NULL || *space != ' ')) return http_request_parser_fail(parser, "malformed request line");
+	http_request->method = http_request_parser_match_method(cursor, (size_t)(space - cursor));
+	if (unlikely(http_request->method == HTTP_METHOD_UNKNOWN))
+		return http_request_parser_fail(parser, "unknown method");
+	cursor = space + 1;
+
+	/* Request target */
+	char *target = cursor;
+	space        = (char *)http_scan_either(cursor, end, ' ', '\n');
+	if (unlikely(space == NULL || *space != ' ' || space == target))
+		return http_request_parser_fail(parser, "malformed request line");
+	char *target_end = space;
+	cursor           = space + 1;
+
+	/* Version */
+	char *newline  = (char *)http_scan_either(cursor, end, '\n', '\n');
+	char *line_end = http_request_parser_line_end(cursor, newline);
+	if (unlikely(line_end - cursor != 8 || memcmp(cursor, "HTTP/1.", 7) != 0
+	             || (cursor[7] != '0' && cursor[7] != '1')))
+		return http_request_parser_fail(parser, "unsupported HTTP version");
+	const bool is_http_1_1 = cursor[7] == '1';
+	cursor                 = newline + 1;
+
+	/* The path excludes the query string and is truncated to fit full_url */
+	char  *query       = (char *)http_scan_either(target, target_end, '?', '?');
+	size_t path_length = (size_t)((query == NULL ? target_end : query) - target);
+	if (path_length > HTTP_MAX_FULL_URL_LENGTH - 1) path_length = HTTP_MAX_FULL_URL_LENGTH - 1;
+	memcpy(http_request->full_url, target, path_length);
+	http_request->full_url[path_length] = '\0';
+
+	if (query != NULL) http_request_parser_parse_query_params(http_request, query + 1, target_end);
+
+	/* Headers, up to the blank line */
+	bool connection_close      = false;
+	bool connection_keep_alive = false;
+	bool chunked               = false;
+	long content_length        = -1;
+
+	while (*cursor != '\n' && !(cursor[0] == '\r' && cursor[1] == '\n')) {
+		char *colon = (char *)http_scan_either(cursor, end, ':', '\n');
+		if (unlikely(colon == NULL || *colon != ':' || colon == cursor))
+			return http_request_parser_fail(parser, "malformed header");
+
+		char  *key        = cursor;
+		size_t key_length = (size_t)(colon - cursor);
+		if (unlikely(key_length > HTTP_MAX_HEADER_LENGTH))
+			return http_request_parser_fail(parser, "header name too long");
+		if (unlikely(http_request->header_count >= HTTP_MAX_HEADER_COUNT))
+			return http_request_parser_fail(parser, "too many headers");
+
+		char *value = colon + 1;
+		while (*value == ' ' || *value == '\t') value++;
+		newline         = (char *)http_scan_either(value, end, '\n', '\n');
+		char *value_end = http_request_parser_line_end(value, newline);
+		while (value_end > value && (value_end[-1] == ' ' || value_end[-1] == '\t')) value_end--;
+
+		size_t value_length = (size_t)(value_end - value);
+		if (unlikely(value_length >= HTTP_MAX_HEADER_VALUE_LENGTH))
+			return http_request_parser_fail(parser, "header value too long");
+
+		struct http_header *header = &http_request->headers[http_request->header_count++];
+		header->key                = key;
+		header->key_length         = (int)key_length;
+		header->value              = value;
+		header->value_length       = (int)value_length;
+
+		if (key_length == 14 && strncasecmp(key, "Content-Length", 14) == 0) {
+			long parsed = 0;
+			for (char *digit = value; digit < value_end; digit++) {
+				if (unlikely(*digit < '0' || *digit > '9'))
+					return http_request_parser_fail(parser, "invalid Content-Length");
+				parsed = parsed * 10 + (*digit - '0');
+				if (unlikely(parsed > INT_MAX))
+					return http_request_parser_fail(parser, "body too large");
+			}
+			if (unlikely(value_length == 0 || (content_length >= 0 && content_length != parsed)))
+				return http_request_parser_fail(parser, "invalid Content-Length");
+			content_length = parsed;
+		} else if (key_length == 17 && strncasecmp(key, "Transfer-Encoding", 17) == 0) {
+			/* chunked must be the final transfer coding */
+			chunked = value_length >= 7 && strncasecmp(value_end - 7, "chunked", 7) == 0;
+		} else if (key_length == 10 && strncasecmp(key, "Connection", 10) == 0) {
+			connection_close |= http_request_parser_has_token(value, value_length, "close");
+			connection_keep_alive |= http_request_parser_has_token(value, value_length, "keep-alive");
+		}
+
+		cursor = newline + 1;
+	}
+
+	http_request->header_end = true;
+	http_request->http_1_1   = is_http_1_1;
+	http_request->keep_alive = is_http_1_1 ? !connection_close : connection_keep_alive;
+
+	/* Ignore the body of HTTP messages other than PUT and POST */
+	if (http_request->method != HTTP_METHOD_PUT && http_request->method != HTTP_METHOD_POST) {
+		http_request->body_length = 0;
+		parser->state             = HTTP_REQUEST_PARSER_DONE;
+	} else if (chunked) {
+		http_request->body_length = -1;
+		parser->state             = HTTP_REQUEST_PARSER_CHUNK_SIZE;
+	} else if (content_length > 0) {
+		http_request->body_length = (int)content_length;
+		parser->state             = HTTP_REQUEST_PARSER_BODY;
+	} else {
+		http_request->body_length = 0;
+		parser->state             = HTTP_REQUEST_PARSER_DONE;
+	}
+
+	return 0;
+}
+
+/**
+ * Parses a chunk size line, ignoring any chunk extensions
+ * @returns the chunk size, or -1 on a malformed line
+ */
+static inline long
+http_request_parser_parse_chunk_size(const char *line, const char *line_end)
+{
+	long        size   = 0;
+	const char *cursor = line;
+
+	for (; cursor < line_end; cursor++) {
+		int digit;
+		if (*cursor >= '0' && *cursor <= '9') {
+			digit = *cursor - '0';
+		} else if ((*cursor | 0x20) >= 'a' && (*cursor | 0x20) <= 'f') {
+			digit = (*cursor | 0x20) - 'a' + 10;
+		} else {
+			break;
+		}
+
+		size = size * 16 + digit;
+		if (unlikely(size > INT_MAX)) return -1;
+	}
+
+	if (unlikely(cursor == line)) return -1;
+	if (unlikely(cursor < line_end && *cursor != ';' && *cursor != ' ' && *cursor != '\t')) return -1;
+
+	return size;
+}
+
+/**
+ * Parses bytes of a request. The request line and headers are only consumed once the head is complete. Chunked
+ * bodies are decoded in place, so the body is always contiguous. Parsing stops at the end of the request, leaving
+ * any bytes of a pipelined request unconsumed.
+ * @param parser
+ * @param http_request
+ * @param data bytes that follow those already consumed
+ * @param length number of bytes in data
+ * @returns number of bytes consumed, -1 on a malformed request. parser->error describes the problem
+ */
+ssize_t
+http_request_parser_execute(struct http_request_parser *parser, struct http_request *http_request, char *data,
+                            size_t length)
+{
+	assert(parser != NULL);
+	assert(http_request != NULL);
+	assert(!http_request->message_end);
+
+	size_t consumed = 0;
+
+	if (parser->state == HTTP_REQUEST_PARSER_HEAD) {
+		size_t head_length = http_request_parser_find_head_end(parser, data, length);
+		if (head_length == 0) {
+			if (unlikely(length > HTTP_MAX_HEAD_LENGTH))
+				return http_request_parser_fail(parser, "request head too large");
+			return 0;
+		}
+
+		if (unlikely(http_request_parser_parse_head(parser, http_request, data, head_length) < 0)) return -1;
+		consumed = head_length;
+	}
+
+	while (consumed < length && parser->state != HTTP_REQUEST_PARSER_DONE) {
+		char  *cursor    = &data[consumed];
+		size_t available = length - consumed;
+
+		switch (parser->state) {
+		case HTTP_REQUEST_PARSER_BODY: {
+			size_t remaining = (size_t)(http_request->body_length - http_request->body_length_read);
+			size_t count     = available < remaining ? available : remaining;
+
+			if (http_request->body == NULL) {
+				http_request->body   = cursor;
+				http_request->cursor = 0;
+			}
+			assert(cursor == &http_request->body[http_request->body_length_read]);
+
+			http_request->body_length_read += (int)count;
+			consumed += count;
+			if (http_request->body_length_read == http_request->body_length)
+				parser->state = HTTP_REQUEST_PARSER_DONE;
+			break;
+		}
+		case HTTP_REQUEST_PARSER_CHUNK_SIZE: {
+			char *newline = (char *)http_scan_either(cursor, cursor + available, '\n', '\n');
+			if (newline == NULL) {
+				if (unlikely(available > HTTP_REQUEST_PARSER_MAX_LINE_LENGTH))
+					return http_request_parser_fail(parser, "chunk size line too long");
+				goto done;
+			}
+
+			long size = http_request_parser_parse_chunk_size(cursor,
+			                                                 http_request_parser_line_end(cursor, newline));
+			if (unlikely(size < 0)) return http_request_parser_fail(parser, "malformed chunk size");
+			if (unlikely(size > INT_MAX - http_request->body_length_read))
+				return http_request_parser_fail(parser, "body too large");
+
+			consumed += (size_t)(newline + 1 - cursor);
+			if (size == 0) {
+				parser->state = HTTP_REQUEST_PARSER_TRAILER;
+			} else {
+				parser->chunk_remaining = (size_t)size;
+				parser->state           = HTTP_REQUEST_PARSER_CHUNK_DATA;
+			}
+			break;
+		}
+		case HTTP_REQUEST_PARSER_CHUNK_DATA: {
+			size_t count = available < parser->chunk_remaining ? available : parser->chunk_remaining;
+
+			if (http_request->body == NULL) {
+				http_request->body   = cursor;
+				http_request->cursor = 0;
+			}
+
+			/* Decode in place by moving the data down over the framing of earlier chunks */
+			char *destination = &http_request->body[http_request->body_length_read];
+			if (destination != cursor) memmove(destination, cursor, count);
+
+			http_request->body_length_read += (int)count;
+			parser->chunk_remaining -= count;
+			consumed += count;
+			if (parser->chunk_remaining == 0) parser->state = HTTP_REQUEST_PARSER_CHUNK_DATA_END;
+			break;
+		}
+		case HTTP_REQUEST_PARSER_CHUNK_DATA_END: {
+			if (cursor[0] == '\n') {
+				consumed += 1;
+			} else if (available < 2) {
+				goto done;
+			} else if (cursor[0] == '\r' && cursor[1] == '\n') {
+				consumed += 2;
+			} else {
+				return http_request_parser_fail(parser, "malformed chunk");
+			}
+			parser->state = HTTP_REQUEST_PARSER_CHUNK_SIZE;
+			break;
+		}
+		case HTTP_REQUEST_PARSER_TRAILER: {
+			char *newline = (char *)http_scan_either(cursor, cursor + available, '\n', '\n');
+			if (newline == NULL) {
+				if (unlikely(available > HTTP_REQUEST_PARSER_MAX_LINE_LENGTH))
+					return http_request_parser_fail(parser, "trailer line too long");
+				goto done;
+			}
+
+			consumed += (size_t)(newline + 1 - cursor);
+			if (http_request_parser_line_end(cursor, newline) == cursor) {
+				http_request->body_length = http_request->body_length_read;
+				parser->state             = HTTP_REQUEST_PARSER_DONE;
+			}
+			break;
+		}
+		default:
+			panic("Invalid HTTP request parser state %d\n", parser->state);
+		}
+	}
+
+done:
+	if (parser->state == HTTP_REQUEST_PARSER_DONE) http_request->message_end = true;
+
+#ifdef LOG_HTTP_PARSER
+	debuglog("parser: %p, state: %d, consumed %zu of %zu\n", parser, parser->state, consumed, length);
+#endif
+
+	return (ssize_t)consumed;
+}
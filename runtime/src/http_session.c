@@ -0,0 +1,4 @@
+#include "http_session.h"
+
+/* Per-thread caches and shared depot of freed sessions */
+DEFINE_OBJECT_CACHE(http_session)
@@ -22,16 +22,26 @@
 
 #include "current_sandbox.h"
 #include "sandbox_types.h"
+#include "slab_buffer.h"
 #include "wasi.h"
 
-/* Return abstract handle */
+/**
+ * Builds a WASI context in an arena. Everything is freed when the arena is reset, so there is no destructor
+ * @returns abstract handle
+ */
 void *
-wasi_context_init(wasi_options_t *options)
+wasi_context_init(wasi_options_t *options, struct arena *arena)
 {
 	/* TODO: Add default types */
 	assert(options != NULL);
+	assert(arena != NULL);
 
-	wasi_context_t *wasi_context = (wasi_context_t *)calloc(1, sizeof(wasi_context_t));
+	wasi_context_t *wasi_context = (wasi_context_t *)arena_alloc(arena, sizeof(wasi_context_t));
+	if (wasi_context == NULL) {
+		fprintf(stderr, "Error allocating wasi_context: %s", strerror(errno));
+		exit(EXIT_FAILURE);
+	}
+	memset(wasi_context, 0, sizeof(wasi_context_t));
 
 	if (options->argc > 0) {
 		assert(options->argv != NULL);
@@ -47,14 +57,14 @@ wasi_context_init(wasi_options_t *options)
 
 		/* Allocate and copy argument sizes and offsets*/
 		wasi_context->argc = options->argc;
-		wasi_context->argv = calloc(options->argc + 1, sizeof(char *));
+		wasi_context->argv = arena_alloc(arena, (options->argc + 1) * sizeof(char *));
 		if (wasi_context->argv == NULL) {
 			fprintf(stderr, "Error allocating argv: %s", strerror(errno));
 			exit(EXIT_FAILURE);
 		}
 
 		wasi_context->argv_buf_size = argv_buf_size;
-		wasi_context->argv_buf      = calloc(argv_buf_size, sizeof(char));
+		wasi_context->argv_buf      = arena_alloc(arena, argv_buf_size);
 		if (wasi_context->argv_buf == NULL) {
 			fprintf(stderr, "Error allocating argv_buf: %s", strerror(errno));
 			exit(EXIT_FAILURE);
@@ -70,6 +80,7 @@ wasi_context_init(wasi_options_t *options)
 		for (int i = 0; i < options->argc; i++) {
 			wasi_context->argv[i] = &(wasi_context->argv_buf[argv_buffer_offsets[i]]);
 		}
+		wasi_context->argv[options->argc] = NULL;
 	} else {
 		wasi_context->argc          = 0;
 		wasi_context->argv          = NULL;
@@ -91,13 +102,13 @@ wasi_context_init(wasi_options_t *options)
 
 	if (envc > 0) {
 		/* Allocate env and env_buf */
-		wasi_context->env = (char **)calloc(envc, sizeof(char **));
+		wasi_context->env = (char **)arena_alloc(arena, envc * sizeof(char *));
 		if (wasi_context->env == NULL) {
 			fprintf(stderr, "Error allocating env: %s", strerror(errno));
 			exit(EXIT_FAILURE);
 		}
 		wasi_context->env_buf_size = env_buf_size;
-		wasi_context->env_buf      = (char *)calloc(env_buf_size, sizeof(char));
+		wasi_context->env_buf      = (char *)arena_alloc(arena, env_buf_size);
 		if (wasi_context->env_buf == NULL) {
 			fprintf(stderr, "Error allocating env_buf: %s", strerror(errno));
 			exit(EXIT_FAILURE);
@@ -122,16 +133,6 @@ wasi_context_init(wasi_options_t *options)
 	return wasi_context;
 }
 
-void
-wasi_context_destroy(wasi_context_t *context)
-{
-	free(context->argv);
-	free(context->argv_buf);
-	free(context->env);
-	free(context->env_buf);
-	free(context);
-}
-
 /* WASI API implementations */
 
 /**
@@ -663,9 +664,12 @@ wasi_snapshot_preview1_backing_fd_read(wasi_context_t *context, __wasi_fd_t fd,
 		struct sandbox      *current_sandbox = current_sandbox_get();
 		struct http_request *current_request = &current_sandbox->http->http_request;
 		int                  old_read        = current_request->cursor;
-		int                  bytes_to_read   = current_request->body_length - old_read;
 
-		assert(current_request->body_length >= 0);
+		/* A streaming request body may not have arrived yet, so this sleeps until more of it is readable */
+		int available     = current_sandbox_wait_for_request_body(old_read);
+		int bytes_to_read = available - old_read;
+
+		assert(available >= 0);
 
 		for (int i = 0; i < iovs_len; i++) {
 			if (bytes_to_read == 0) goto done;
@@ -673,7 +677,7 @@ wasi_snapshot_preview1_backing_fd_read(wasi_context_t *context, __wasi_fd_t fd,
 			int amount_to_copy = iovs[i].buf_len > bytes_to_read ? bytes_to_read : iovs[i].buf_len;
 			memcpy(iovs[i].buf, current_request->body + current_request->cursor, amount_to_copy);
 			current_request->cursor += amount_to_copy;
-			bytes_to_read = current_request->body_length - current_request->cursor;
+			bytes_to_read = available - current_request->cursor;
 		}
 
 	done:
@@ -798,11 +802,21 @@ wasi_snapshot_preview1_backing_fd_write(wasi_context_t *context, __wasi_fd_t fd,
 				debuglog("STDERR from Sandbox: %.*s", iovs[i].buf_len, iovs[i].buf);
 			}
 #endif
-			rc = fwrite(iovs[i].buf, 1, iovs[i].buf_len, s->http->response_body.handle);
-			if (rc != iovs[i].buf_len) return __WASI_ERRNO_FBIG;
+			rc = slab_buffer_write(&s->http->response_body, iovs[i].buf, iovs[i].buf_len);
+			if (rc < 0) return __WASI_ERRNO_FBIG;
 
-			nwritten += rc;
+			nwritten += iovs[i].buf_len;
 		}
+
+		/*
+		 * Routes that stream their response send each chunk once enough output is buffered. HTTP/1.0 clients
+		 * do not understand chunked responses, so they get the whole response with a Content-Length instead.
+		 */
+		if (s->route->stream_response && s->http->http_request.http_1_1
+		    && s->http->response_body.size >= runtime_response_chunk_size) {
+			if (current_sandbox_send_response_chunk() < 0) return __WASI_ERRNO_PIPE;
+		}
+
 		*nwritten_retptr = nwritten;
 		return __WASI_ERRNO_SUCCESS;
 	}
@@ -8,12 +8,15 @@
 #include "listener_thread.h"
 #include "metrics_server.h"
 #include "module.h"
+#include "numa_topology.h"
 #include "runtime.h"
 #include "sandbox_functions.h"
 #include "sandbox_perf_log.h"
+#include "software_interrupt.h"
 #include "tcp_session.h"
 #include "tenant.h"
 #include "tenant_functions.h"
+#include "worker_wakeup_queue.h"
 
 static void listener_thread_unregister_http_session(struct http_session *http);
 static void panic_on_epoll_error(struct epoll_event *evt);
@@ -23,60 +26,104 @@ static void on_tenant_socket_epoll_event(struct epoll_event *evt);
 static void on_client_request_arrival(int client_socket, const struct sockaddr *client_address, struct tenant *tenant);
 static void on_client_request_receiving(struct http_session *session);
 static void on_client_request_received(struct http_session *session);
-static void on_client_response_header_sending(struct http_session *session);
-static void on_client_response_body_sending(struct http_session *session);
+static void on_client_request_body_streaming_start(struct http_session *session);
+static void on_client_request_body_streaming(struct http_session *session, int rc);
+static void on_client_response_sending(struct http_session *session);
+static void on_client_response_writable(struct http_session *session);
 static void on_client_response_sent(struct http_session *session);
+static void on_client_session_idle_readable(struct http_session *session);
+static void on_client_session_closed(struct http_session *session);
 
-/*
- * Descriptor of the epoll instance used to monitor the socket descriptors of registered
- * serverless modules. The listener cores listens for incoming client requests through this.
- */
-int listener_thread_epoll_file_descriptor;
+/* Array of runtime_listener_threads_count listener threads, each with a private epoll instance */
+struct listener_thread *listener_threads = NULL;
 
-pthread_t listener_thread_id;
+/* Index of the executing listener thread in listener_threads. -1 when not running on a listener thread */
+thread_local int listener_thread_idx = -1;
 
 /**
- * Initializes the listener thread, pinned to core 0, and starts to listen for requests
+ * Initializes the listener threads, pinned to consecutive cores starting at LISTENER_THREAD_CORE_ID, and starts to
+ * listen for requests
  */
 void
 listener_thread_initialize(void)
 {
-	printf("Starting listener thread\n");
-	cpu_set_t cs;
+	printf("Starting %u listener thread(s)\n", runtime_listener_threads_count);
 
-	CPU_ZERO(&cs);
-	CPU_SET(LISTENER_THREAD_CORE_ID, &cs);
+	listener_threads = calloc(runtime_listener_threads_count, sizeof(struct listener_thread));
+	if (listener_threads == NULL) panic("Failed to allocate listener threads\n");
 
-	/* Setup epoll */
-	listener_thread_epoll_file_descriptor = epoll_create1(0);
-	assert(listener_thread_epoll_file_descriptor >= 0);
+	for (int i = 0; i < runtime_listener_threads_count; i++) {
+		struct listener_thread *listener = &listener_threads[i];
+		listener->idx                    = i;
 
-	int ret = pthread_create(&listener_thread_id, NULL, listener_thread_main, NULL);
-	assert(ret == 0);
-	ret = pthread_setaffinity_np(listener_thread_id, sizeof(cpu_set_t), &cs);
-	assert(ret == 0);
-	ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cs);
-	assert(ret == 0);
+		/* Setup epoll */
+		listener->epoll_file_descriptor = epoll_create1(0);
+		assert(listener->epoll_file_descriptor >= 0);
+
+		lock_init(&listener->idle_sessions_lock);
+		ps_list_head_init(&listener->idle_sessions);
+	}
+
+	for (int i = 0; i < runtime_listener_threads_count; i++) {
+		cpu_set_t cs;
+		CPU_ZERO(&cs);
+		CPU_SET(LISTENER_THREAD_CORE_ID + i, &cs);
 
-	printf("\tListener core thread: %lx\n", listener_thread_id);
+		int ret = pthread_create(&listener_threads[i].id, NULL, listener_thread_main, &listener_threads[i]);
+		assert(ret == 0);
+		ret = pthread_setaffinity_np(listener_threads[i].id, sizeof(cpu_set_t), &cs);
+		assert(ret == 0);
+
+		printf("\tListener core thread %d: %lx\n", i, listener_threads[i].id);
+	}
+
+	/* The main thread only sleeps on pthread_join, so it shares the core of the first listener */
+	cpu_set_t cs;
+	CPU_ZERO(&cs);
+	CPU_SET(LISTENER_THREAD_CORE_ID, &cs);
+	int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cs);
+	assert(ret == 0);
 }
 
 /**
- * @brief Registers a serverless tenant on the listener thread's epoll descriptor
+ * @brief Registers an http session on the epoll descriptor of the listener thread that accepted it. This is also
+ * called by worker threads when a response would block or when a persistent connection becomes idle.
  **/
 void
 listener_thread_register_http_session(struct http_session *http)
 {
 	assert(http != NULL);
 
-	if (unlikely(listener_thread_epoll_file_descriptor == 0)) {
+	if (unlikely(listener_threads == NULL)) {
 		panic("Attempting to register an http session before listener thread initialization");
 	}
+	assert(http->listener_thread_idx >= 0 && http->listener_thread_idx < runtime_listener_threads_count);
 
-	int                rc = 0;
-	struct epoll_event accept_evt;
+	struct listener_thread *listener = &listener_threads[http->listener_thread_idx];
+	int                     rc       = 0;
+	struct epoll_event      accept_evt;
 	accept_evt.data.ptr = (void *)http;
 
+	/*
+	 * Idle sessions are added to the idle list and to epoll under the same lock, so the listener never sees the
+	 * session readable or expired while only one of the two has happened
+	 */
+	if (http->state == HTTP_SESSION_INITIALIZED) {
+		assert(http->requests_served > 0);
+		accept_evt.events    = EPOLLIN;
+		http->state          = HTTP_SESSION_KEEP_ALIVE_IDLE;
+		http->idle_timestamp = __getcycles();
+
+		lock_node_t node = {};
+		lock_lock(&listener->idle_sessions_lock, &node);
+		ps_list_head_append_d(&listener->idle_sessions, http);
+		rc = epoll_ctl(listener->epoll_file_descriptor, EPOLL_CTL_ADD, http->socket, &accept_evt);
+		lock_unlock(&listener->idle_sessions_lock, &node);
+
+		if (rc != 0) { panic("Failed to add idle http session to listener thread epoll\n"); }
+		return;
+	}
+
 	switch (http->state) {
 	case HTTP_SESSION_RECEIVING_REQUEST:
 		accept_evt.events = EPOLLIN;
@@ -90,39 +137,45 @@ listener_thread_register_http_session(struct http_session *http)
 		accept_evt.events = EPOLLOUT;
 		http->state       = HTTP_SESSION_SEND_RESPONSE_BODY_BLOCKED;
 		break;
+	case HTTP_SESSION_STREAMING_RESPONSE:
+		accept_evt.events = EPOLLOUT;
+		http->state       = HTTP_SESSION_STREAM_RESPONSE_BLOCKED;
+		break;
 	default:
 		panic("Invalid HTTP Session State: %d\n", http->state);
 	}
 
-	rc = epoll_ctl(listener_thread_epoll_file_descriptor, EPOLL_CTL_ADD, http->socket, &accept_evt);
+	rc = epoll_ctl(listener->epoll_file_descriptor, EPOLL_CTL_ADD, http->socket, &accept_evt);
 	if (rc != 0) { panic("Failed to add http session to listener thread epoll\n"); }
 }
 
 /**
- * @brief Registers a serverless tenant on the listener thread's epoll descriptor
+ * @brief Unregisters an http session from the epoll descriptor of the listener thread that owns it
  **/
 static void
 listener_thread_unregister_http_session(struct http_session *http)
 {
 	assert(http != NULL);
 
-	if (unlikely(listener_thread_epoll_file_descriptor == 0)) {
+	if (unlikely(listener_threads == NULL)) {
 		panic("Attempting to unregister an http session before listener thread initialization");
 	}
 
-	int rc = epoll_ctl(listener_thread_epoll_file_descriptor, EPOLL_CTL_DEL, http->socket, NULL);
+	int rc = epoll_ctl(listener_threads[http->listener_thread_idx].epoll_file_descriptor, EPOLL_CTL_DEL,
+	                   http->socket, NULL);
 	if (rc != 0) { panic("Failed to remove http session from listener thread epoll\n"); }
 }
 
 /**
- * @brief Registers a serverless tenant on the listener thread's epoll descriptor
+ * @brief Registers a serverless tenant on the epoll descriptors of all listener threads. Listener i waits on
+ * the i-th SO_REUSEPORT socket of the tenant.
  * Assumption: We never have to unregister a tenant
  **/
 int
 listener_thread_register_tenant(struct tenant *tenant)
 {
 	assert(tenant != NULL);
-	if (unlikely(listener_thread_epoll_file_descriptor == 0)) {
+	if (unlikely(listener_threads == NULL)) {
 		panic("Attempting to register a tenant before listener thread initialization");
 	}
 
@@ -130,8 +183,12 @@ listener_thread_register_tenant(struct tenant *tenant)
 	struct epoll_event accept_evt;
 	accept_evt.data.ptr = (void *)tenant;
 	accept_evt.events   = EPOLLIN;
-	rc = epoll_ctl(listener_thread_epoll_file_descriptor, EPOLL_CTL_ADD, tenant->tcp_server.socket_descriptor,
-	               &accept_evt);
+
+	for (int i = 0; i < runtime_listener_threads_count; i++) {
+		rc = epoll_ctl(listener_threads[i].epoll_file_descriptor, EPOLL_CTL_ADD,
+		               tenant->tcp_servers[i].socket_descriptor, &accept_evt);
+		if (unlikely(rc < 0)) break;
+	}
 
 	return rc;
 }
@@ -139,20 +196,73 @@ listener_thread_register_tenant(struct tenant *tenant)
 int
 listener_thread_register_metrics_server()
 {
-	if (unlikely(listener_thread_epoll_file_descriptor == 0)) {
-		panic("Attempting to register metrics_server before listener thread initialization");
-	}
+	assert(listener_thread_is_running());
 
 	int                rc = 0;
 	struct epoll_event accept_evt;
 	accept_evt.data.ptr = (void *)&metrics_server;
 	accept_evt.events   = EPOLLIN;
-	rc = epoll_ctl(listener_thread_epoll_file_descriptor, EPOLL_CTL_ADD, metrics_server.tcp.socket_descriptor,
-	               &accept_evt);
+	rc = epoll_ctl(listener_threads[listener_thread_idx].epoll_file_descriptor, EPOLL_CTL_ADD,
+	               metrics_server.tcp.socket_descriptor, &accept_evt);
 
 	return rc;
 }
 
+/**
+ * @brief Removes an idle persistent connection from the idle list of the executing listener thread
+ **/
+static void
+listener_thread_remove_idle_http_session(struct http_session *http)
+{
+	assert(http->listener_thread_idx == listener_thread_idx);
+
+	struct listener_thread *listener = &listener_threads[listener_thread_idx];
+
+	lock_node_t node = {};
+	lock_lock(&listener->idle_sessions_lock, &node);
+	ps_list_rem_d(http);
+	lock_unlock(&listener->idle_sessions_lock, &node);
+}
+
+/**
+ * @brief Closes the persistent connections that have been idle for longer than the keep-alive timeout
+ * @returns the number of milliseconds until the next idle session expires. Workers park sessions without waking the
+ * listener, so with no idle sessions this is the keep-alive timeout, which bounds how long a session parked in the
+ * meantime outlives it. -1 if keep-alive is disabled
+ **/
+static int
+listener_thread_expire_idle_http_sessions(void)
+{
+	struct listener_thread *listener = &listener_threads[listener_thread_idx];
+	const uint64_t          timeout  = (uint64_t)runtime_http_keep_alive_timeout_ms * 1000
+	                         * runtime_processor_speed_MHz;
+	int next_expiration_ms = runtime_http_keep_alive_timeout_ms > 0 ? (int)runtime_http_keep_alive_timeout_ms : -1;
+
+	lock_node_t node = {};
+	lock_lock(&listener->idle_sessions_lock, &node);
+
+	while (!ps_list_head_empty(&listener->idle_sessions)) {
+		struct http_session *session = ps_list_head_first_d(&listener->idle_sessions, struct http_session);
+		assert(session->state == HTTP_SESSION_KEEP_ALIVE_IDLE);
+
+		const uint64_t idle_duration = __getcycles() - session->idle_timestamp;
+		if (idle_duration < timeout) {
+			/* Round up so epoll_wait does not wake up just before the session expires */
+			const uint64_t cycles_per_ms = (uint64_t)runtime_processor_speed_MHz * 1000;
+			next_expiration_ms           = (int)((timeout - idle_duration + cycles_per_ms - 1) / cycles_per_ms);
+			break;
+		}
+
+		ps_list_rem_d(session);
+		listener_thread_unregister_http_session(session);
+		on_client_session_closed(session);
+	}
+
+	lock_unlock(&listener->idle_sessions_lock, &node);
+
+	return next_expiration_ms;
+}
+
 static void
 panic_on_epoll_error(struct epoll_event *evt)
 {
@@ -176,7 +286,7 @@ on_client_request_arrival(int client_socket, const struct sockaddr *client_addre
 
 	/* Allocate HTTP Session */
 	struct http_session *session = http_session_alloc(client_socket, (const struct sockaddr *)&client_address,
-	                                                  tenant, request_arrival_timestamp);
+	                                                  tenant, listener_thread_idx, request_arrival_timestamp);
 	if (likely(session != NULL)) {
 		on_client_request_receiving(session);
 		return;
@@ -185,7 +295,7 @@ on_client_request_arrival(int client_socket, const struct sockaddr *client_addre
 		debuglog("Failed to allocate http session\n");
 		session->state = HTTP_SESSION_EXECUTION_COMPLETE;
 		http_session_set_response_header(session, 500);
-		on_client_response_header_sending(session);
+		on_client_response_sending(session);
 		return;
 	}
 }
@@ -195,6 +305,10 @@ on_client_request_receiving(struct http_session *session)
 {
 	/* Read HTTP request */
 	int rc = http_session_receive_request(session, (void_star_cb)listener_thread_register_http_session);
+	if (unlikely(rc == -ENOTCONN)) {
+		on_client_session_closed(session);
+		return;
+	}
 
 	/* Check if the route is accurate only when the URL is downloaded. Stop downloading if inaccurate. */
 	if (session->route == NULL && strlen(session->http_request.full_url) > 0) {
@@ -203,13 +317,19 @@ on_client_request_receiving(struct http_session *session)
 			debuglog("Did not match any routes\n");
 			session->state = HTTP_SESSION_EXECUTION_COMPLETE;
 			http_session_set_response_header(session, 404);
-			on_client_response_header_sending(session);
+			on_client_response_sending(session);
 			return;
 		}
 
 		session->route = route;
 	}
 
+	/* The sandbox of a streaming request already owns the response, so only hand it the rest of the body */
+	if (session->request_body_streaming) {
+		on_client_request_body_streaming(session, rc);
+		return;
+	}
+
 	if (rc == 0) {
 #ifdef EXECUTION_REGRESSION
 		if (!session->did_preprocessing) tenant_preprocess(session);
@@ -223,26 +343,32 @@ on_client_request_receiving(struct http_session *session)
 		if (!session->did_preprocessing && session->http_request.body_length_read > 4096)
 			tenant_preprocess(session);
 #endif
+		if (session->route != NULL && session->route->stream_request_body
+		    && session->http_request.header_end && session->http_request.body_length > 0)
+			on_client_request_body_streaming_start(session);
 		return;
 	} else if (rc < 0) {
 		debuglog("Failed to receive or parse request\n");
 		session->state = HTTP_SESSION_EXECUTION_COMPLETE;
 		http_session_set_response_header(session, 400);
-		on_client_response_header_sending(session);
+		on_client_response_sending(session);
 		return;
 	}
 
 	assert(0);
 }
 
-static void
-on_client_request_received(struct http_session *session)
+/**
+ * @brief Allocates a sandbox for the request of a session and adds it to the global request scheduler. On success,
+ * a worker may already be executing the sandbox, so the caller must not touch the session anymore.
+ * @returns 0 if the sandbox was dispatched, or else the status code of the error response to send
+ **/
+static int
+listener_thread_dispatch_sandbox(struct http_session *session)
 {
-	assert(session->state == HTTP_SESSION_RECEIVED_REQUEST);
-	session->request_downloaded_timestamp = __getcycles();
-	struct route *route                   = session->route;
-	uint64_t      estimated_execution     = route->execution_histogram.estimated_execution;
-	uint64_t      work_admitted           = 1;
+	struct route *route               = session->route;
+	uint64_t      estimated_execution = route->execution_histogram.estimated_execution;
+	uint64_t      work_admitted       = 1;
 
 #ifdef EXECUTION_REGRESSION
 	estimated_execution = get_regression_prediction(session);
@@ -256,27 +382,21 @@ on_client_request_received(struct http_session *session)
 	uint64_t admissions_estimate = admissions_control_calculate_estimate(estimated_execution,
 	                                                                     route->relative_deadline);
 	work_admitted                = admissions_control_decide(admissions_estimate);
-	if (work_admitted == 0) {
-		session->state = HTTP_SESSION_EXECUTION_COMPLETE;
-		http_session_set_response_header(session, 429);
-		on_client_response_header_sending(session);
-		return;
-	}
+	if (work_admitted == 0) return 429;
 #endif
 
 	/* Allocate a Sandbox */
-	session->state          = HTTP_SESSION_EXECUTING;
 	struct sandbox *sandbox = sandbox_alloc(route->module, session, route, session->tenant, work_admitted);
 	if (unlikely(sandbox == NULL)) {
 		debuglog("Failed to allocate sandbox\n");
-		session->state = HTTP_SESSION_EXECUTION_COMPLETE;
-		http_session_set_response_header(session, 500);
-		on_client_response_header_sending(session);
-		return;
+		return 500;
 	}
 
 	sandbox->remaining_exec = estimated_execution;
 
+	/* Read before the add, as a worker may take the sandbox as soon as it is queued */
+	uint64_t absolute_deadline = sandbox->absolute_deadline;
+
 	/* If the global request scheduler is full, return a 429 to the client */
 	if (unlikely(global_request_scheduler_add(sandbox) == NULL)) {
 		// debuglog("Failed to add sandbox to global queue\n");
@@ -285,34 +405,114 @@ on_client_request_received(struct http_session *session)
 		sandbox_perf_log_print_entry(sandbox);
 		sandbox->http = NULL;
 		sandbox_free(sandbox);
+		return 429;
+	}
+
+	software_interrupt_preempt_for_arrival(absolute_deadline, global_request_scheduler_last_node);
+
+	return 0;
+}
+
+static void
+on_client_request_received(struct http_session *session)
+{
+	assert(session->state == HTTP_SESSION_RECEIVED_REQUEST);
+	session->request_downloaded_timestamp = __getcycles();
+
+	/* The whole request has been read, so any response can leave the connection open for the next one */
+	session->keep_alive = http_session_should_keep_alive(session);
+
+	session->state  = HTTP_SESSION_EXECUTING;
+	int status_code = listener_thread_dispatch_sandbox(session);
+	if (unlikely(status_code != 0)) {
 		session->state = HTTP_SESSION_EXECUTION_COMPLETE;
-		http_session_set_response_header(session, 429);
-		on_client_response_header_sending(session);
+		http_session_set_response_header(session, status_code);
+		on_client_response_sending(session);
 	}
 }
 
+/**
+ * @brief Publishes how much of a streaming request body has been received, waking the sandbox if it went to sleep
+ * waiting for more. Once complete is set, the sandbox may respond and free the session at any point, so the
+ * caller must not touch the session afterwards.
+ **/
 static void
-on_client_response_header_sending(struct http_session *session)
+listener_thread_publish_request_body(struct http_session *session, bool complete)
 {
-	int rc = http_session_send_response_header(session, (void_star_cb)listener_thread_register_http_session);
-	if (likely(rc == 0)) {
-		on_client_response_body_sending(session);
-		return;
-	} else if (unlikely(rc == -EAGAIN)) {
-		/* session blocked and registered to epoll so continue to next handle */
+	lock_node_t node = {};
+	lock_lock(&session->request_body_lock, &node);
+	session->request_body_available = session->http_request.body_length_read;
+	session->request_body_complete  = complete;
+	struct sandbox *waiter          = session->request_body_waiter;
+	int             waiter_worker   = session->request_body_waiter_worker;
+	session->request_body_waiter    = NULL;
+	lock_unlock(&session->request_body_lock, &node);
+
+	if (waiter != NULL) worker_wakeup_queue_push(waiter_worker, waiter);
+}
+
+/**
+ * @brief Dispatches the sandbox of a route that streams its request body as soon as the headers are parsed. The
+ * body is moved into a memfd_buffer first, so it does not move while the sandbox reads it. The session stays
+ * registered to epoll, and the listener keeps receiving the body.
+ **/
+static void
+on_client_request_body_streaming_start(struct http_session *session)
+{
+	assert(session->state == HTTP_SESSION_RECEIVE_REQUEST_BLOCKED);
+	assert(!session->http_request.message_end);
+
+	if (session->request_body_buffer.data == NULL && http_session_move_request_body_to_buffer(session) < 0) {
+		/* Fall back to dispatching once the whole body has been received */
 		return;
-	} else if (rc < 0) {
-		http_session_close(session);
-		http_session_free(session);
+	}
+
+	session->request_body_streaming = true;
+	session->request_body_available = session->http_request.body_length_read;
+	session->request_body_complete  = false;
+	session->request_body_waiter    = NULL;
+
+	int status_code = listener_thread_dispatch_sandbox(session);
+	if (unlikely(status_code != 0)) {
+		session->request_body_streaming = false;
+		listener_thread_unregister_http_session(session);
+		session->keep_alive = false;
+		session->state      = HTTP_SESSION_EXECUTION_COMPLETE;
+		http_session_set_response_header(session, status_code);
+		on_client_response_sending(session);
+	}
+}
+
+/**
+ * @brief Called when more of a streaming request body was received, or receiving it ended
+ * @param rc the return code of http_session_receive_request
+ **/
+static void
+on_client_request_body_streaming(struct http_session *session, int rc)
+{
+	if (rc == -EAGAIN) {
+		/* session blocked and registered to epoll, so continue to next handle */
+		listener_thread_publish_request_body(session, false);
 		return;
 	}
+
+	if (rc == 0) {
+		session->request_downloaded_timestamp = __getcycles();
+		session->keep_alive                   = http_session_should_keep_alive(session);
+	} else {
+		/* The sandbox sees a truncated body and the connection is closed after its response */
+		debuglog("Failed to receive or parse streaming request body\n");
+		session->keep_alive = false;
+	}
+
+	session->state = HTTP_SESSION_EXECUTING;
+	listener_thread_publish_request_body(session, true);
 }
 
 static void
-on_client_response_body_sending(struct http_session *session)
+on_client_response_sending(struct http_session *session)
 {
-	/* Read HTTP request */
-	int rc = http_session_send_response_body(session, (void_star_cb)listener_thread_register_http_session);
+	int rc = http_session_send_response_buffers(session, (void_star_cb)listener_thread_register_http_session);
 	if (likely(rc == 0)) {
 		on_client_response_sent(session);
 		return;
@@ -326,6 +526,24 @@ on_client_response_body_sending(struct http_session *session)
 	}
 }
 
+/**
+ * @brief Wakes the sandbox of a streaming response that went to sleep because the socket would block. The sandbox
+ * sends the rest of its chunk itself.
+ **/
+static void
+on_client_response_writable(struct http_session *session)
+{
+	assert(session->state == HTTP_SESSION_STREAM_RESPONSE_BLOCKED);
+	assert(session->response_waiter != NULL);
+
+	struct sandbox *waiter        = session->response_waiter;
+	int             waiter_worker = session->response_waiter_worker;
+	session->response_waiter      = NULL;
+	session->state                = HTTP_SESSION_STREAMING_RESPONSE;
+
+	worker_wakeup_queue_push(waiter_worker, waiter);
+}
+
 static void
 on_client_response_sent(struct http_session *session)
 {
@@ -334,12 +552,45 @@ on_client_response_sent(struct http_session *session)
 	/* Terminal State Logging for Http Session */
 	session->response_sent_timestamp = __getcycles();
 	http_session_perf_log_print_entry(session);
+	session->requests_served++;
+
+	if (session->keep_alive) {
+		http_session_reset(session);
+		listener_thread_register_http_session(session);
+		return;
+	}
 
 	http_session_close(session);
 	http_session_free(session);
 	return;
 }
 
+/**
+ * @brief Called when a persistent connection waiting for its next request becomes readable
+ **/
+static void
+on_client_session_idle_readable(struct http_session *session)
+{
+	assert(session->state == HTTP_SESSION_KEEP_ALIVE_IDLE);
+
+	listener_thread_remove_idle_http_session(session);
+
+	http_total_increment_request();
+	session->request_arrival_timestamp = __getcycles();
+	session->state                     = HTTP_SESSION_INITIALIZED;
+	on_client_request_receiving(session);
+}
+
+/**
+ * @brief Called when a persistent connection is closed by the client or expires between requests
+ **/
+static void
+on_client_session_closed(struct http_session *session)
+{
+	http_session_close(session);
+	http_session_free(session);
+}
+
 static void
 on_tenant_socket_epoll_event(struct epoll_event *evt)
 {
@@ -354,8 +605,8 @@ on_tenant_socket_epoll_event(struct epoll_event *evt)
 
 	/* Accept as many clients requests as possible, returning when we would have blocked */
 	while (true) {
-		int client_socket = accept4(tenant->tcp_server.socket_descriptor, (struct sockaddr *)&client_address,
-		                            &address_length, SOCK_NONBLOCK);
+		int client_socket = accept4(tenant->tcp_servers[listener_thread_idx].socket_descriptor,
+		                            (struct sockaddr *)&client_address, &address_length, SOCK_NONBLOCK);
 		if (unlikely(client_socket < 0)) {
 			if (errno == EWOULDBLOCK || errno == EAGAIN) return;
 
@@ -406,12 +657,15 @@ on_client_socket_epoll_event(struct epoll_event *evt)
 		on_client_request_receiving(session);
 		break;
 	case HTTP_SESSION_SEND_RESPONSE_HEADER_BLOCKED:
-		assert((evt->events & EPOLLOUT) == EPOLLOUT);
-		on_client_response_header_sending(session);
-		break;
 	case HTTP_SESSION_SEND_RESPONSE_BODY_BLOCKED:
 		assert((evt->events & EPOLLOUT) == EPOLLOUT);
-		on_client_response_body_sending(session);
+		on_client_response_sending(session);
+		break;
+	case HTTP_SESSION_STREAM_RESPONSE_BLOCKED:
+		on_client_response_writable(session);
+		break;
+	case HTTP_SESSION_KEEP_ALIVE_IDLE:
+		on_client_session_idle_readable(session);
 		break;
 	default:
 		panic("Invalid HTTP Session State");
@@ -421,38 +675,40 @@ on_client_socket_epoll_event(struct epoll_event *evt)
 /**
  * @brief Execution Loop of the listener core, io_handles HTTP requests, allocates sandbox request objects, and
  * pushes the sandbox object to the global dequeue
- * @param dummy data pointer provided by pthreads API. Unused in this function
+ * @param argument the struct listener_thread owned by this thread
  * @return NULL
- *
- * Used Globals:
- * listener_thread_epoll_file_descriptor - the epoll file descriptor
- *
  */
 noreturn void *
-listener_thread_main(void *dummy)
+listener_thread_main(void *argument)
 {
-	struct epoll_event epoll_events[RUNTIME_MAX_EPOLL_EVENTS];
+	struct listener_thread *listener = (struct listener_thread *)argument;
+	struct epoll_event      epoll_events[RUNTIME_MAX_EPOLL_EVENTS];
 
-	metrics_server_init();
-	listener_thread_register_metrics_server();
+	listener_thread_idx      = listener->idx;
+	numa_topology_local_node = numa_topology_node_of_cpu(LISTENER_THREAD_CORE_ID + listener->idx);
+
+	/* The metrics server is a single socket, so only the first listener serves it */
+	if (listener_thread_idx == 0) {
+		metrics_server_init();
+		listener_thread_register_metrics_server();
+	}
 
 	/* Set my priority */
 	// runtime_set_pthread_prio(pthread_self(), 2);
 	pthread_setschedprio(pthread_self(), -20);
 
+	int timeout_ms = runtime_http_keep_alive_timeout_ms > 0 ? (int)runtime_http_keep_alive_timeout_ms : -1;
+
 	while (true) {
-		/* Block indefinitely on the epoll file descriptor, waiting on up to a max number of events */
-		int descriptor_count = epoll_wait(listener_thread_epoll_file_descriptor, epoll_events,
-		                                  RUNTIME_MAX_EPOLL_EVENTS, -1);
+		/* Block on the epoll file descriptor until an event arrives or the next idle session expires */
+		int descriptor_count = epoll_wait(listener->epoll_file_descriptor, epoll_events, RUNTIME_MAX_EPOLL_EVENTS,
+		                                  timeout_ms);
 		if (descriptor_count < 0) {
 			if (errno == EINTR) continue;
 
 			panic("epoll_wait: %s", strerror(errno));
 		}
 
-		/* Assumption: Because epoll_wait is set to not timeout, we should always have descriptors here */
-		assert(descriptor_count > 0);
-
 		for (int i = 0; i < descriptor_count; i++) {
 			panic_on_epoll_error(&epoll_events[i]);
 
@@ -472,6 +728,8 @@ listener_thread_main(void *dummy)
 				panic("Unknown epoll type!");
 			}
 		}
+
+		timeout_ms = listener_thread_expire_idle_http_sessions();
 	}
 
 	panic("Listener thread unexpectedly broke loop\n");
@@ -5,13 +5,28 @@
 #include <threads.h>
 
 #include "local_runqueue.h"
+#include "numa_topology.h"
+#include "panic.h"
+#include "runtime.h"
+#include "worker_thread.h"
 
 static struct local_runqueue_config local_runqueue;
 
+struct local_runqueue_slot *local_runqueue_slots = NULL;
+
 #ifdef LOG_LOCAL_RUNQUEUE
 thread_local uint32_t local_runqueue_count = 0;
 #endif
 
+/**
+ * @returns true if other workers may steal from the runqueues, in which case the owner takes its slot's lock
+ */
+static inline bool
+local_runqueue_is_shared(void)
+{
+	return runtime_work_stealing_enabled && local_runqueue.steal_fn != NULL;
+}
+
 /* Initializes a concrete implementation of the sandbox request scheduler interface */
 void
 local_runqueue_initialize(struct local_runqueue_config *config)
@@ -19,6 +34,45 @@ local_runqueue_initialize(struct local_runqueue_config *config)
 	memcpy(&local_runqueue, config, sizeof(struct local_runqueue_config));
 }
 
+/**
+ * Allocates the slots through which workers steal from each other. Called once, before the workers start
+ */
+void
+local_runqueue_slots_initialize(void)
+{
+	local_runqueue_slots = calloc(runtime_worker_threads_count, sizeof(struct local_runqueue_slot));
+	if (local_runqueue_slots == NULL) panic("Failed to allocate local runqueue slots\n");
+
+	for (int i = 0; i < runtime_worker_threads_count; i++) lock_init(&local_runqueue_slots[i].lock);
+}
+
+/**
+ * Publishes the calling worker's runqueue to thieves. Variants call this when they create the runqueue and again
+ * whenever it moves
+ * @param runqueue
+ */
+void
+local_runqueue_publish(void *runqueue)
+{
+	local_runqueue_slots[worker_thread_idx].runqueue = runqueue;
+}
+
+/**
+ * Takes the calling worker's slot lock if thieves may access its runqueue
+ * @param node
+ */
+void
+local_runqueue_lock(lock_node_t *node)
+{
+	if (local_runqueue_is_shared()) lock_lock(&local_runqueue_slots[worker_thread_idx].lock, node);
+}
+
+void
+local_runqueue_unlock(lock_node_t *node)
+{
+	if (local_runqueue_is_shared()) lock_unlock(&local_runqueue_slots[worker_thread_idx].lock, node);
+}
+
 /**
  * Adds a sandbox to the run queue
  * @param sandbox to add
@@ -30,7 +84,11 @@ local_runqueue_add(struct sandbox *sandbox)
 #ifdef LOG_LOCAL_RUNQUEUE
 	local_runqueue_count++;
 #endif
-	return local_runqueue.add_fn(sandbox);
+	lock_node_t node = {};
+	local_runqueue_lock(&node);
+	local_runqueue.add_fn(sandbox);
+	atomic_fetch_add_explicit(&local_runqueue_slots[worker_thread_idx].length, 1, memory_order_relaxed);
+	local_runqueue_unlock(&node);
 }
 
 /**
@@ -44,7 +102,11 @@ local_runqueue_delete(struct sandbox *sandbox)
 #ifdef LOG_LOCAL_RUNQUEUE
 	local_runqueue_count--;
 #endif
+	lock_node_t node = {};
+	local_runqueue_lock(&node);
 	local_runqueue.delete_fn(sandbox);
+	atomic_fetch_sub_explicit(&local_runqueue_slots[worker_thread_idx].length, 1, memory_order_relaxed);
+	local_runqueue_unlock(&node);
 }
 
 /**
@@ -55,7 +117,11 @@ bool
 local_runqueue_is_empty()
 {
 	assert(local_runqueue.is_empty_fn != NULL);
-	return local_runqueue.is_empty_fn();
+	lock_node_t node = {};
+	local_runqueue_lock(&node);
+	bool is_empty = local_runqueue.is_empty_fn();
+	local_runqueue_unlock(&node);
+	return is_empty;
 }
 
 /**
@@ -66,5 +132,65 @@ struct sandbox *
 local_runqueue_get_next()
 {
 	assert(local_runqueue.get_next_fn != NULL);
-	return local_runqueue.get_next_fn();
+	lock_node_t node = {};
+	local_runqueue_lock(&node);
+	struct sandbox *next = local_runqueue.get_next_fn();
+	local_runqueue_unlock(&node);
+	return next;
 };
+
+/**
+ * Tries to steal a sandbox from the worker's slot
+ * @param victim_idx
+ * @returns the stolen sandbox or NULL
+ */
+static inline struct sandbox *
+local_runqueue_steal_from(int victim_idx)
+{
+	struct local_runqueue_slot *victim = &local_runqueue_slots[victim_idx];
+
+	lock_node_t node = {};
+	lock_lock(&victim->lock, &node);
+	struct sandbox *stolen = local_runqueue.steal_fn(victim->runqueue);
+	if (stolen != NULL) atomic_fetch_sub_explicit(&victim->length, 1, memory_order_relaxed);
+	lock_unlock(&victim->lock, &node);
+
+	return stolen;
+}
+
+/**
+ * Steals a sandbox for the calling worker, which has nothing to run. The victim is the worker with the longest
+ * runqueue, looking at the workers of the caller's NUMA node before the others. The stolen sandbox is the highest
+ * priority stealable sandbox of the victim, so EDF and SJF order are kept across workers.
+ * The caller adds the sandbox to its own runqueue.
+ * @returns a runnable sandbox that has not started or NULL
+ */
+struct sandbox *
+local_runqueue_steal(void)
+{
+	if (!local_runqueue_is_shared()) return NULL;
+
+	for (int pass = 0; pass < 2; pass++) {
+		int      victim_idx    = -1;
+		uint32_t victim_length = 1; /* The head of a runqueue is never stolen */
+		for (int i = 1; i < runtime_worker_threads_count; i++) {
+			int idx = (worker_thread_idx + i) % runtime_worker_threads_count;
+
+			bool same_node = runtime_worker_threads_numa_node[idx] == numa_topology_local_node;
+			if (same_node != (pass == 0)) continue;
+
+			uint32_t length = atomic_load_explicit(&local_runqueue_slots[idx].length, memory_order_relaxed);
+			if (length > victim_length) {
+				victim_idx    = idx;
+				victim_length = length;
+			}
+		}
+
+		if (victim_idx < 0) continue;
+
+		struct sandbox *stolen = local_runqueue_steal_from(victim_idx);
+		if (stolen != NULL) return stolen;
+	}
+
+	return NULL;
+}
@@ -55,12 +55,41 @@ local_runqueue_list_append(struct sandbox *sandbox_to_append)
 void
 local_runqueue_list_rotate()
 {
+	lock_node_t node = {};
+	local_runqueue_lock(&node);
+
 	/* If runqueue is size one, skip round robin logic since tail equals head */
-	if (ps_list_head_one_node(&local_runqueue_list)) return;
+	if (!ps_list_head_one_node(&local_runqueue_list)) {
+		struct sandbox *sandbox_at_head = local_runqueue_list_remove_and_return();
+		assert(sandbox_at_head->state == SANDBOX_INTERRUPTED);
+		local_runqueue_list_append(sandbox_at_head);
+	}
+
+	local_runqueue_unlock(&node);
+}
+
+/**
+ * Removes the stealable sandbox nearest the head of another worker's runqueue, which has waited the longest
+ * @param runqueue the victim's list, locked by the caller
+ * @return the stolen sandbox or NULL if none are stealable
+ */
+static struct sandbox *
+local_runqueue_list_steal(void *runqueue)
+{
+	struct ps_list_head *list = (struct ps_list_head *)runqueue;
+	if (list == NULL || ps_list_head_empty(list)) return NULL;
+
+	struct sandbox *head    = ps_list_head_first_d(list, struct sandbox);
+	struct sandbox *sandbox = NULL;
+	ps_list_foreach_d(list, sandbox)
+	{
+		if (sandbox == head || !local_runqueue_is_stealable(sandbox)) continue;
+
+		ps_list_rem_d(sandbox);
+		return sandbox;
+	}
 
-	struct sandbox *sandbox_at_head = local_runqueue_list_remove_and_return();
-	assert(sandbox_at_head->state == SANDBOX_INTERRUPTED);
-	local_runqueue_list_append(sandbox_at_head);
+	return NULL;
 }
 
 /**
@@ -79,11 +108,13 @@ void
 local_runqueue_list_initialize()
 {
 	ps_list_head_init(&local_runqueue_list);
+	local_runqueue_publish(&local_runqueue_list);
 
 	/* Register Function Pointers for Abstract Scheduling API */
 	struct local_runqueue_config config = {.add_fn      = local_runqueue_list_append,
 	                                       .is_empty_fn = local_runqueue_list_is_empty,
 	                                       .delete_fn   = local_runqueue_list_remove,
-	                                       .get_next_fn = local_runqueue_list_get_next};
+	                                       .get_next_fn = local_runqueue_list_get_next,
+	                                       .steal_fn    = local_runqueue_list_steal};
 	local_runqueue_initialize(&config);
 };
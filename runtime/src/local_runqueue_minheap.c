@@ -37,6 +37,7 @@ local_runqueue_minheap_add(struct sandbox *sandbox)
 		struct priority_queue *temp = priority_queue_grow_nolock(local_runqueue_minheap);
 		if (unlikely(temp == NULL)) panic("Failed to grow local runqueue\n");
 		local_runqueue_minheap = temp;
+		local_runqueue_publish(local_runqueue_minheap);
 		return_code            = priority_queue_enqueue_nolock(local_runqueue_minheap, sandbox);
 		if (unlikely(return_code == -ENOSPC)) panic("Thread Runqueue is full!\n");
 	}
@@ -74,6 +75,38 @@ local_runqueue_minheap_get_next()
 	return next;
 }
 
+/**
+ * Removes the highest priority stealable sandbox from another worker's runqueue. The heap is scanned past its head,
+ * as stealable sandboxes can sit anywhere below it
+ * @param runqueue the victim's minheap, locked by the caller
+ * @return the stolen sandbox or NULL if none are stealable
+ */
+static struct sandbox *
+local_runqueue_minheap_steal(void *runqueue)
+{
+	struct priority_queue *minheap = (struct priority_queue *)runqueue;
+	if (minheap == NULL) return NULL;
+
+	struct sandbox *stolen          = NULL;
+	uint64_t        stolen_priority = UINT64_MAX;
+	for (size_t i = 2; i <= minheap->size; i++) {
+		struct sandbox *sandbox = (struct sandbox *)minheap->items[i];
+		if (!local_runqueue_is_stealable(sandbox)) continue;
+
+		uint64_t priority = minheap->get_priority_fn(sandbox);
+		if (stolen == NULL || priority < stolen_priority) {
+			stolen          = sandbox;
+			stolen_priority = priority;
+		}
+	}
+
+	if (stolen == NULL) return NULL;
+
+	int rc = priority_queue_delete_nolock(minheap, stolen);
+	assert(rc == 0);
+	return stolen;
+}
+
 /**
  * Registers the PS variant with the polymorphic interface
  */
@@ -82,12 +115,14 @@ local_runqueue_minheap_initialize()
 {
 	/* Initialize local state */
 	local_runqueue_minheap = priority_queue_initialize(RUNTIME_RUNQUEUE_SIZE, false, sandbox_get_priority);
+	local_runqueue_publish(local_runqueue_minheap);
 
 	/* Register Function Pointers for Abstract Scheduling API */
 	struct local_runqueue_config config = {.add_fn      = local_runqueue_minheap_add,
 	                                       .is_empty_fn = local_runqueue_minheap_is_empty,
 	                                       .delete_fn   = local_runqueue_minheap_delete,
-	                                       .get_next_fn = local_runqueue_minheap_get_next};
+	                                       .get_next_fn = local_runqueue_minheap_get_next,
+	                                       .steal_fn    = local_runqueue_minheap_steal};
 
 	local_runqueue_initialize(&config);
 }
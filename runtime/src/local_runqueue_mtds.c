@@ -225,6 +225,15 @@ local_runqueue_mtds_demote(struct perworker_tenant_sandbox_queue *pwt)
 }
 
 
+/**
+ * @returns true if a tenant timer in the LOCAL queue has run out, so a tenant is due to be promoted
+ */
+bool
+local_timeout_queue_promotion_due()
+{
+	return priority_queue_peek(worker_thread_timeout_queue) <= __getcycles();
+}
+
 /*
  * Checks if there are any tenant timers that run out in the LOCAL queue,
  *  if so promote that tenant.
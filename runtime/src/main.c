@@ -1,5 +1,6 @@
 #include <ctype.h>
 #include <dlfcn.h>
+#include <limits.h>
 #include <math.h>
 #include <pthread.h>
 #include <sched.h>
@@ -20,6 +21,8 @@
 #include "debuglog.h"
 #include "json_parse.h"
 #include "listener_thread.h"
+#include "module_refiller.h"
+#include "numa_topology.h"
 #include "panic.h"
 #include "pretty_print.h"
 #include "runtime.h"
@@ -36,15 +39,30 @@ uint32_t runtime_first_worker_processor  = 1;
 uint32_t runtime_processor_speed_MHz     = 0;
 uint32_t runtime_total_online_processors = 0;
 uint32_t runtime_worker_threads_count    = 0;
+uint32_t runtime_listener_threads_count  = 1;
 
 enum RUNTIME_SIGALRM_HANDLER runtime_sigalrm_handler = RUNTIME_SIGALRM_HANDLER_BROADCAST;
 
 bool     runtime_preemption_enabled            = true;
 bool     runtime_worker_spinloop_pause_enabled = false;
-uint32_t runtime_quantum_us                    = 1000; /* 1ms */
+bool     runtime_work_stealing_enabled         = true;
+bool     runtime_tickless_enabled              = true;
+bool     runtime_arrival_preemption_enabled    = true;
+uint32_t runtime_quantum_us                    = 1000;  /* 1ms */
+uint32_t runtime_http_keep_alive_timeout_ms    = 5000;  /* 0 disables persistent connections */
+uint32_t runtime_http_keep_alive_max_requests  = 1000;  /* 0 means unlimited */
+uint32_t runtime_request_body_memfd_threshold  = 0;     /* 0 disables zero-copy request bodies */
+uint32_t runtime_response_chunk_size           = 16384; /* Output buffered before a streaming route sends a chunk */
+uint32_t runtime_pool_capacity                 = 64;    /* Objects of each kind in a module's depot, 0 = no cap */
+uint32_t runtime_pool_global_capacity          = 0;     /* Objects pooled across modules and threads, 0 = no cap */
+uint32_t runtime_pool_idle_trim_ms             = 1000;  /* 0 disables trimming idle pooled objects */
+uint32_t runtime_pool_rss_limit_mb             = 0;     /* 0 disables shrinking pools under memory pressure */
 uint64_t runtime_boot_timestamp;
 pid_t    runtime_pid = 0;
 
+/* The tightest relative deadline of any route, in cycles. Lowered as tenants are loaded */
+uint64_t runtime_min_relative_deadline = UINT64_MAX;
+
 /**
  * Returns instructions on use of CLI if used incorrectly
  * @param cmd - The command the user entered
@@ -68,10 +86,24 @@ runtime_allocate_available_cores()
 
 	pretty_print_key_value("Core Count (Online)", "%u\n", runtime_total_online_processors);
 
-	/* If more than two cores are available, leave core 0 free to run OS tasks */
-	if (runtime_total_online_processors > 2) {
-		runtime_first_worker_processor = 2;
-		max_possible_workers           = runtime_total_online_processors - 2;
+	/* Number of Listeners */
+	char *listener_count_raw = getenv("SLEDGE_NLISTENERS");
+	if (listener_count_raw != NULL) {
+		/* Listeners leave a core for at least one worker, except on two cores, where the only listener shares
+		 * its core with the worker */
+		int listener_count     = atoi(listener_count_raw);
+		int max_listener_count = (int)runtime_total_online_processors - LISTENER_THREAD_CORE_ID - 1;
+		if (max_listener_count < 1) max_listener_count = 1;
+		if (listener_count <= 0 || listener_count > max_listener_count) {
+			panic("Invalid Listener Count. Was %d. Must be {1..%d}\n", listener_count, max_listener_count);
+		}
+		runtime_listener_threads_count = listener_count;
+	}
+
+	/* If enough cores are available, leave core 0 free to run OS tasks. Listeners take the following cores */
+	if (runtime_total_online_processors > runtime_listener_threads_count + 1) {
+		runtime_first_worker_processor = LISTENER_THREAD_CORE_ID + runtime_listener_threads_count;
+		max_possible_workers           = runtime_total_online_processors - runtime_first_worker_processor;
 	} else if (runtime_total_online_processors == 2) {
 		runtime_first_worker_processor = 1;
 		max_possible_workers           = runtime_total_online_processors - 1;
@@ -92,9 +124,12 @@ runtime_allocate_available_cores()
 		runtime_worker_threads_count = max_possible_workers;
 	}
 
-	pretty_print_key_value("Listener core ID", "%u\n", LISTENER_THREAD_CORE_ID);
+	pretty_print_key_value("First Listener core ID", "%u\n", LISTENER_THREAD_CORE_ID);
+	pretty_print_key_value("Listener core count", "%u\n", runtime_listener_threads_count);
 	pretty_print_key_value("First Worker core ID", "%u\n", runtime_first_worker_processor);
 	pretty_print_key_value("Worker core count", "%u\n", runtime_worker_threads_count);
+
+	numa_topology_initialize();
 }
 
 static inline uint64_t
@@ -189,6 +224,23 @@ runtime_process_debug_log_behavior()
 void
 runtime_start_runtime_worker_threads()
 {
+	/* Group the worker cores by NUMA node, so the workers of a node get consecutive indices */
+	int *worker_processors = calloc(runtime_worker_threads_count, sizeof(int));
+	assert(worker_processors != NULL);
+	int worker_idx = 0;
+	for (int node = 0; node < numa_topology_node_count; node++) {
+		for (int i = 0; i < runtime_worker_threads_count; i++) {
+			int processor = runtime_first_worker_processor + i;
+			if (numa_topology_node_of_cpu(processor) != node) continue;
+
+			worker_processors[worker_idx]                = processor;
+			runtime_worker_threads_numa_node[worker_idx] = node;
+			numa_topology_node_worker_count[node]++;
+			worker_idx++;
+		}
+	}
+	assert(worker_idx == runtime_worker_threads_count);
+
 	printf("Starting %d worker thread(s)\n", runtime_worker_threads_count);
 	for (int i = 0; i < runtime_worker_threads_count; i++) {
 		/* Pass the value we want the threads to use when indexing into global arrays of per-thread values */
@@ -203,10 +255,12 @@ runtime_start_runtime_worker_threads()
 
 		cpu_set_t cs;
 		CPU_ZERO(&cs);
-		CPU_SET(runtime_first_worker_processor + i, &cs);
+		CPU_SET(worker_processors[i], &cs);
 		ret = pthread_setaffinity_np(runtime_worker_threads[i], sizeof(cs), &cs);
 		assert(ret == 0);
 	}
+
+	free(worker_processors);
 }
 
 void
@@ -239,7 +293,6 @@ runtime_configure()
 	if (strcmp(sigalrm_policy, "BROADCAST") == 0) {
 		runtime_sigalrm_handler = RUNTIME_SIGALRM_HANDLER_BROADCAST;
 	} else if (strcmp(sigalrm_policy, "TRIAGED") == 0) {
-		if (unlikely(scheduler != SCHEDULER_EDF)) panic("triaged sigalrm handlers are only valid with EDF\n");
 		runtime_sigalrm_handler = RUNTIME_SIGALRM_HANDLER_TRIAGED;
 	} else {
 		panic("Invalid sigalrm policy: %s. Must be {BROADCAST|TRIAGED}\n", sigalrm_policy);
@@ -263,6 +316,140 @@ runtime_configure()
 	}
 	pretty_print_key_value("Quantum", "%u us\n", runtime_quantum_us);
 
+	/* Tickless Quantum Toggle. MTDS accounts tenant budgets and promotes tenants on every quantum, so it keeps a
+	 * periodic timer */
+	char *tickless_disable = getenv("SLEDGE_DISABLE_TICKLESS");
+	if (tickless_disable != NULL && strcmp(tickless_disable, "false") != 0) runtime_tickless_enabled = false;
+	if (!runtime_preemption_enabled || scheduler == SCHEDULER_MTDS || scheduler == SCHEDULER_MTDBF)
+		runtime_tickless_enabled = false;
+	pretty_print_key_value("Tickless Quantum", "%s\n",
+	                       runtime_tickless_enabled ? PRETTY_PRINT_GREEN_ENABLED : PRETTY_PRINT_RED_DISABLED);
+
+	/* Arrival Preemption Toggle. The listener signals the worker running the latest deadline when an earlier
+	 * deadline arrives, which only orders work under EDF */
+	char *arrival_preemption_disable = getenv("SLEDGE_DISABLE_ARRIVAL_PREEMPTION");
+	if (arrival_preemption_disable != NULL && strcmp(arrival_preemption_disable, "false") != 0)
+		runtime_arrival_preemption_enabled = false;
+	if (!runtime_preemption_enabled || scheduler != SCHEDULER_EDF) runtime_arrival_preemption_enabled = false;
+	pretty_print_key_value("Arrival Preemption", "%s\n",
+	                       runtime_arrival_preemption_enabled ? PRETTY_PRINT_GREEN_ENABLED
+	                                                          : PRETTY_PRINT_RED_DISABLED);
+
+	/* Work Stealing Toggle. MTDS keeps per-worker tenant queues, so its runqueues cannot be stolen from */
+	char *work_stealing_disable = getenv("SLEDGE_DISABLE_WORK_STEALING");
+	if (work_stealing_disable != NULL && strcmp(work_stealing_disable, "false") != 0)
+		runtime_work_stealing_enabled = false;
+	if (scheduler == SCHEDULER_MTDS || scheduler == SCHEDULER_MTDBF) runtime_work_stealing_enabled = false;
+	pretty_print_key_value("Work Stealing", "%s\n",
+	                       runtime_work_stealing_enabled ? PRETTY_PRINT_GREEN_ENABLED : PRETTY_PRINT_RED_DISABLED);
+
+	/* HTTP Keep-Alive */
+	char *keep_alive_timeout_raw = getenv("SLEDGE_HTTP_KEEP_ALIVE_TIMEOUT_MS");
+	if (keep_alive_timeout_raw != NULL) {
+		long keep_alive_timeout = atol(keep_alive_timeout_raw);
+		if (unlikely(keep_alive_timeout < 0 || keep_alive_timeout > INT_MAX))
+			panic("SLEDGE_HTTP_KEEP_ALIVE_TIMEOUT_MS must be a non-negative integer, saw %ld\n",
+			      keep_alive_timeout);
+		runtime_http_keep_alive_timeout_ms = (uint32_t)keep_alive_timeout;
+	}
+
+	char *keep_alive_max_requests_raw = getenv("SLEDGE_HTTP_KEEP_ALIVE_MAX_REQUESTS");
+	if (keep_alive_max_requests_raw != NULL) {
+		long keep_alive_max_requests = atol(keep_alive_max_requests_raw);
+		if (unlikely(keep_alive_max_requests < 0 || keep_alive_max_requests > UINT32_MAX))
+			panic("SLEDGE_HTTP_KEEP_ALIVE_MAX_REQUESTS must be a non-negative integer, saw %ld\n",
+			      keep_alive_max_requests);
+		runtime_http_keep_alive_max_requests = (uint32_t)keep_alive_max_requests;
+	}
+
+	/* Zero-Copy Request Bodies */
+	char *memfd_threshold_raw = getenv("SLEDGE_REQUEST_BODY_MEMFD_THRESHOLD");
+	if (memfd_threshold_raw != NULL) {
+		long memfd_threshold = atol(memfd_threshold_raw);
+		if (unlikely(memfd_threshold < 0 || memfd_threshold > INT_MAX))
+			panic("SLEDGE_REQUEST_BODY_MEMFD_THRESHOLD must be a non-negative integer, saw %ld\n",
+			      memfd_threshold);
+		runtime_request_body_memfd_threshold = (uint32_t)memfd_threshold;
+	}
+	if (runtime_request_body_memfd_threshold == 0) {
+		pretty_print_key_disabled("Zero-Copy Request Body");
+	} else {
+		pretty_print_key_value("Zero-Copy Request Body Threshold", "%u bytes\n",
+		                       runtime_request_body_memfd_threshold);
+	}
+
+	/* Streaming Responses */
+	char *response_chunk_size_raw = getenv("SLEDGE_RESPONSE_CHUNK_SIZE");
+	if (response_chunk_size_raw != NULL) {
+		long response_chunk_size = atol(response_chunk_size_raw);
+		if (unlikely(response_chunk_size <= 0 || response_chunk_size > INT_MAX))
+			panic("SLEDGE_RESPONSE_CHUNK_SIZE must be a positive integer, saw %ld\n", response_chunk_size);
+		runtime_response_chunk_size = (uint32_t)response_chunk_size;
+	}
+	pretty_print_key_value("Streaming Response Chunk Size", "%u bytes\n", runtime_response_chunk_size);
+
+	/* Module Pools */
+	char *pool_capacity_raw = getenv("SLEDGE_POOL_CAPACITY");
+	if (pool_capacity_raw != NULL) {
+		long pool_capacity = atol(pool_capacity_raw);
+		if (unlikely(pool_capacity < 0 || pool_capacity > INT_MAX))
+			panic("SLEDGE_POOL_CAPACITY must be a non-negative integer, saw %ld\n", pool_capacity);
+		runtime_pool_capacity = (uint32_t)pool_capacity;
+	}
+
+	char *pool_global_capacity_raw = getenv("SLEDGE_POOL_GLOBAL_CAPACITY");
+	if (pool_global_capacity_raw != NULL) {
+		long pool_global_capacity = atol(pool_global_capacity_raw);
+		if (unlikely(pool_global_capacity < 0 || pool_global_capacity > INT_MAX))
+			panic("SLEDGE_POOL_GLOBAL_CAPACITY must be a non-negative integer, saw %ld\n",
+			      pool_global_capacity);
+		runtime_pool_global_capacity = (uint32_t)pool_global_capacity;
+	}
+
+	char *pool_idle_trim_raw = getenv("SLEDGE_POOL_IDLE_TRIM_MS");
+	if (pool_idle_trim_raw != NULL) {
+		long pool_idle_trim_ms = atol(pool_idle_trim_raw);
+		if (unlikely(pool_idle_trim_ms < 0 || pool_idle_trim_ms > INT_MAX))
+			panic("SLEDGE_POOL_IDLE_TRIM_MS must be a non-negative integer, saw %ld\n", pool_idle_trim_ms);
+		runtime_pool_idle_trim_ms = (uint32_t)pool_idle_trim_ms;
+	}
+
+	char *pool_rss_limit_raw = getenv("SLEDGE_POOL_RSS_LIMIT_MB");
+	if (pool_rss_limit_raw != NULL) {
+		long pool_rss_limit_mb = atol(pool_rss_limit_raw);
+		if (unlikely(pool_rss_limit_mb < 0 || pool_rss_limit_mb > INT_MAX))
+			panic("SLEDGE_POOL_RSS_LIMIT_MB must be a non-negative integer, saw %ld\n", pool_rss_limit_mb);
+		runtime_pool_rss_limit_mb = (uint32_t)pool_rss_limit_mb;
+	}
+
+	if (runtime_pool_capacity == 0) {
+		pretty_print_key_disabled("Module Pool Capacity");
+	} else {
+		pretty_print_key_value("Module Pool Capacity", "%u per module\n", runtime_pool_capacity);
+	}
+	if (runtime_pool_global_capacity == 0) {
+		pretty_print_key_disabled("Module Pool Global Capacity");
+	} else {
+		pretty_print_key_value("Module Pool Global Capacity", "%u\n", runtime_pool_global_capacity);
+	}
+	if (runtime_pool_idle_trim_ms == 0) {
+		pretty_print_key_disabled("Module Pool Idle Trimming");
+	} else {
+		pretty_print_key_value("Module Pool Idle Trim", "%u ms\n", runtime_pool_idle_trim_ms);
+	}
+	if (runtime_pool_rss_limit_mb == 0) {
+		pretty_print_key_disabled("Module Pool RSS Limit");
+	} else {
+		pretty_print_key_value("Module Pool RSS Limit", "%u MB\n", runtime_pool_rss_limit_mb);
+	}
+
+	if (runtime_http_keep_alive_timeout_ms == 0) {
+		pretty_print_key_disabled("HTTP Keep-Alive");
+	} else {
+		pretty_print_key_value("HTTP Keep-Alive Timeout", "%u ms\n", runtime_http_keep_alive_timeout_ms);
+		pretty_print_key_value("HTTP Keep-Alive Max Requests", "%u\n", runtime_http_keep_alive_max_requests);
+	}
+
 	sandbox_perf_log_init();
 	http_session_perf_log_init();
 }
@@ -516,7 +703,6 @@ main(int argc, char **argv)
 	runtime_start_runtime_worker_threads();
 	runtime_get_processor_speed_MHz();
 	runtime_configure_worker_spinloop_pause();
-	software_interrupt_arm_timer();
 
 #ifdef LOG_TENANT_LOADING
 	debuglog("Parsing <spec.json> file [%s]\n", argv[1]);
@@ -545,6 +731,9 @@ main(int argc, char **argv)
 		if (rc < 0) exit(-1);
 	}
 
+	/* Prefault the warm pools now that the modules are loaded */
+	module_refiller_initialize();
+
 	runtime_boot_timestamp = __getcycles();
 
 	for (int tenant_idx = 0; tenant_idx < tenant_config_vec_len; tenant_idx++) {
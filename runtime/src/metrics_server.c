@@ -9,6 +9,7 @@
 #include "http.h"
 #include "http_total.h"
 #include "metrics_server.h"
+#include "module.h"
 #include "proc_stat.h"
 #include "runtime.h"
 #include "sandbox_state.h"
@@ -77,6 +78,8 @@ metrics_server_handler(void *arg)
 
 	if (strncmp(http_status_code_buf, "GET /metrics HTTP", 10) != 0) {
 		write(client_socket, http_header_build(404), http_header_len(404));
+		write(client_socket, HTTP_RESPONSE_CONNECTION_CLOSE HTTP_RESPONSE_TERMINATOR,
+		      strlen(HTTP_RESPONSE_CONNECTION_CLOSE HTTP_RESPONSE_TERMINATOR));
 		close(client_socket);
 		pthread_exit(NULL);
 	}
@@ -97,6 +100,12 @@ metrics_server_handler(void *arg)
 
 	uint64_t total_sandboxes = atomic_load(&sandbox_total);
 
+	uint32_t pooled_objects          = atomic_load(&module_pools_pooled);
+	uint64_t pool_dropped_total      = atomic_load(&module_pools_dropped_total);
+	uint64_t pool_trimmed_idle_total = atomic_load(&module_pools_trimmed_idle_total);
+	uint64_t pool_trimmed_pressure   = atomic_load(&module_pools_trimmed_pressure_total);
+	uint64_t pool_released_pressure  = atomic_load(&module_pools_released_pressure_total);
+
 #ifdef SANDBOX_STATE_TOTALS
 	uint32_t total_sandboxes_uninitialized = atomic_load(&sandbox_state_totals[SANDBOX_UNINITIALIZED]);
 	uint32_t total_sandboxes_allocated     = atomic_load(&sandbox_state_totals[SANDBOX_ALLOCATED]);
@@ -122,7 +131,7 @@ metrics_server_handler(void *arg)
 	proc_stat_metrics_init(&stat);
 #endif
 
-	fprintf(ostream, HTTP_RESPONSE_200_OK HTTP_RESPONSE_TERMINATOR);
+	fprintf(ostream, HTTP_RESPONSE_200_OK HTTP_RESPONSE_CONNECTION_CLOSE HTTP_RESPONSE_TERMINATOR);
 
 #ifdef PROC_STAT_METRICS
 	fprintf(ostream, "# TYPE os_proc_major_page_faults counter\n");
@@ -171,6 +180,21 @@ metrics_server_handler(void *arg)
 	fprintf(ostream, "# TYPE total_sandboxes counter\n");
 	fprintf(ostream, "total_sandboxes: %lu\n", total_sandboxes);
 
+	fprintf(ostream, "# TYPE module_pool_objects gauge\n");
+	fprintf(ostream, "module_pool_objects: %u\n", pooled_objects);
+
+	fprintf(ostream, "# TYPE module_pool_dropped_total counter\n");
+	fprintf(ostream, "module_pool_dropped_total: %lu\n", pool_dropped_total);
+
+	fprintf(ostream, "# TYPE module_pool_trimmed_idle_total counter\n");
+	fprintf(ostream, "module_pool_trimmed_idle_total: %lu\n", pool_trimmed_idle_total);
+
+	fprintf(ostream, "# TYPE module_pool_trimmed_pressure_total counter\n");
+	fprintf(ostream, "module_pool_trimmed_pressure_total: %lu\n", pool_trimmed_pressure);
+
+	fprintf(ostream, "# TYPE module_pool_released_pressure_total counter\n");
+	fprintf(ostream, "module_pool_released_pressure_total: %lu\n", pool_released_pressure);
+
 #ifdef SANDBOX_STATE_TOTALS
 	fprintf(ostream, "# TYPE total_sandboxes_uninitialized gauge\n");
 	fprintf(ostream, "total_sandboxes_uninitialized: %d\n", total_sandboxes_uninitialized);
@@ -1,11 +1,14 @@
 #include <assert.h>
 #include <dlfcn.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <unistd.h>
 
 #include "debuglog.h"
+#include "arch/getcycles.h"
 #include "http.h"
 #include "likely.h"
 #include "listener_thread.h"
@@ -17,10 +20,108 @@
 #include "tcp_server.h"
 #include "wasm_table.h"
 
+_Atomic uint32_t module_pools_pooled                  = 0;
+_Atomic uint64_t module_pools_dropped_total           = 0;
+_Atomic uint64_t module_pools_trimmed_idle_total      = 0;
+_Atomic uint64_t module_pools_trimmed_pressure_total  = 0;
+_Atomic uint64_t module_pools_released_pressure_total = 0;
+
 /*************************
  * Private Static Inline *
  ************************/
 
+static inline bool
+module_page_is_zero(const uint8_t *page)
+{
+	const uint64_t *words = (const uint64_t *)page;
+	for (size_t i = 0; i < PAGE_SIZE / sizeof(uint64_t); i++) {
+		if (words[i] != 0) return false;
+	}
+	return true;
+}
+
+/**
+ * Runs the module's initialize_memory once on a scratch linear memory and keeps the result in a memfd, so
+ * instances map the initialized memory copy-on-write instead of replaying the data segments. Only pages that hold
+ * data are written to the memfd, and the rest stay holes that read as zeros.
+ *
+ * As with module_initialize_table, this fakes out the current instance and depends on module_alloc only being
+ * invoked at program start.
+ * @param module
+ * @returns 0 on success, -1 on error, leaving the module without a snapshot
+ */
+static inline int
+module_initialize_memory_snapshot(struct module *module)
+{
+	uint64_t starting_bytes = (uint64_t)module->abi.starting_pages * WASM_PAGE_SIZE;
+	uint64_t max_bytes      = (uint64_t)module->abi.max_pages * WASM_PAGE_SIZE;
+	if (starting_bytes == 0) return -1;
+
+	struct wasm_memory *scratch = wasm_memory_alloc(starting_bytes, max_bytes);
+	if (scratch == NULL) return -1;
+
+	assert(sledge_abi__current_wasm_module_instance.abi.memory.buffer == NULL);
+	memcpy(&sledge_abi__current_wasm_module_instance.abi.memory, &scratch->abi,
+	       sizeof(struct sledge_abi__wasm_memory));
+	module->abi.initialize_memory();
+	memset(&sledge_abi__current_wasm_module_instance.abi.memory, 0, sizeof(struct sledge_abi__wasm_memory));
+
+	if (memfd_buffer_init(&module->memory_snapshot, starting_bytes) < 0) {
+		wasm_memory_free(scratch);
+		return -1;
+	}
+
+	for (uint64_t offset = 0; offset < starting_bytes; offset += PAGE_SIZE) {
+		if (module_page_is_zero(&scratch->abi.buffer[offset])) continue;
+		memcpy(&module->memory_snapshot.data[offset], &scratch->abi.buffer[offset], PAGE_SIZE);
+	}
+
+	wasm_memory_free(scratch);
+	return 0;
+}
+
+/**
+ * Faults in a range of pages ahead of use, so the instance that gets them does not take the page faults
+ * @param buffer page-aligned start of the range
+ * @param size bytes to fault in
+ * @param write whether to populate private writable pages rather than just map the pages for reading. Without
+ * MADV_POPULATE_*, this writes zeros, so it is only used for memory that is still all zeros
+ */
+static inline void
+module_prefault(uint8_t *buffer, size_t size, bool write)
+{
+#ifdef MADV_POPULATE_WRITE
+	if (madvise(buffer, size, write ? MADV_POPULATE_WRITE : MADV_POPULATE_READ) == 0) return;
+#endif
+
+	/* Older kernels do not support MADV_POPULATE_*, so touch each page instead */
+	volatile uint8_t *pages = buffer;
+	for (size_t offset = 0; offset < size; offset += PAGE_SIZE) {
+		if (write) {
+			pages[offset] = 0;
+		} else {
+			(void)pages[offset];
+		}
+	}
+}
+
+/**
+ * Gives the pages of a pooled object back to the kernel while keeping it mapped. The pages are only reclaimed if
+ * memory runs short, and read as zeros once they are, so this is only used on objects that were zeroed when pooled
+ * @param buffer page-aligned start of the range
+ * @param size bytes to release
+ */
+static inline void
+module_release_pages(uint8_t *buffer, size_t size)
+{
+#ifdef MADV_FREE
+	if (madvise(buffer, size, MADV_FREE) == 0) return;
+#endif
+
+	/* Kernels without MADV_FREE drop the pages right away */
+	madvise(buffer, size, MADV_DONTNEED);
+}
+
 /**
  * Initializes a module
  *
@@ -42,8 +143,8 @@ module_init(struct module *module, char *path, uint32_t stack_size)
 	rc = sledge_abi_symbols_init(&module->abi, path);
 	if (rc != 0) goto err;
 
-	module->pools = calloc((module->type == APP_MODULE ? runtime_worker_threads_count : 1),
-	                       sizeof(struct module_pool));
+	module->pools  = calloc(module_pools_count(module), sizeof(struct module_pool));
+	module->depots = calloc(numa_topology_node_count, sizeof(struct module_depot));
 
 	module->path = path;
 
@@ -51,6 +152,13 @@ module_init(struct module *module, char *path, uint32_t stack_size)
 	module->stack_size = ((uint32_t)(round_up_to_page(stack_size == 0 ? WASM_STACK_SIZE : stack_size)));
 
 	module_alloc_table(module);
+
+	module->memory_snapshot.fd = -1;
+	if (module_initialize_memory_snapshot(module) < 0) {
+		fprintf(stderr, "Failed to snapshot linear memory of %s, instances will initialize it themselves\n",
+		        path);
+	}
+
 	module_initialize_pools(module);
 done:
 	return rc;
@@ -69,7 +177,9 @@ module_deinit(struct module *module)
 	sledge_abi_symbols_deinit(&module->abi);
 	/* TODO: Free indirect_table */
 	module_deinitialize_pools(module);
+	memfd_buffer_deinit(&module->memory_snapshot);
 	free(module->pools);
+	free(module->depots);
 }
 
 /***************************************
@@ -97,6 +207,243 @@ module_free(struct module *module)
 	free(module);
 }
 
+/**
+ * Backs the module's linear memories with transparent huge pages. Called while loading tenants, before any memory
+ * of the module is allocated.
+ *
+ * Pages mapped copy-on-write from the memory snapshot are copied into small pages when written, so such a module
+ * drops its snapshot and each instance runs initialize_memory on anonymous memory instead.
+ * @param module
+ */
+void
+module_use_huge_pages(struct module *module)
+{
+	if (module->huge_pages) return;
+	module->huge_pages = true;
+
+	memfd_buffer_deinit(&module->memory_snapshot);
+
+	/* Warn if the kernel will ignore MADV_HUGEPAGE */
+	FILE *thp = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r");
+	if (thp == NULL) {
+		fprintf(stderr, "Warning: %s asked for huge pages, but transparent huge pages are unavailable\n",
+		        module->path);
+		return;
+	}
+
+	char mode[128] = {0};
+	if (fgets(mode, sizeof(mode), thp) != NULL && strstr(mode, "[never]") != NULL) {
+		fprintf(stderr, "Warning: %s asked for huge pages, but transparent huge pages are disabled\n",
+		        module->path);
+	}
+	fclose(thp);
+}
+
+/**
+ * Tops up the warm pools of every worker to the module's warm-instances target with new prefaulted linear memories
+ * and stacks. Called by the refiller thread, which is the only thread that adds to the warm pools. The refiller runs
+ * on the reserved OS core, so each object is bound to the NUMA node of its worker before it is faulted in
+ * @param module
+ */
+void
+module_refill_warm_pools(struct module *module)
+{
+	assert(module->type == APP_MODULE);
+
+	/* Warm objects would only add to the pressure that the workers are trimming their pools to relieve */
+	if (module_pools_under_pressure()) return;
+
+	uint64_t starting_bytes = (uint64_t)module->abi.starting_pages * WASM_PAGE_SIZE;
+
+	for (int i = 0; i < module_pools_count(module); i++) {
+		struct module_pool *pool = &module->pools[i];
+		const int           node = runtime_worker_threads_numa_node[i];
+
+		while (atomic_load(&pool->warm_memory_count) < module->warm_instances) {
+			struct wasm_memory *memory = module_create_linear_memory(module);
+			if (memory == NULL) return;
+
+			/* Bound after the snapshot is mapped, as mapping it replaces the policy */
+			numa_topology_bind(memory->abi.buffer, WASM_MEMORY_SIZE_TO_ALLOC, node);
+
+			/* Snapshot pages are only mapped, so an instance that never writes a page does not copy it.
+			 * Without a snapshot, the instance writes to zeroed pages anyway */
+			bool write = module->memory_snapshot.data == NULL;
+			if (starting_bytes > 0) module_prefault(memory->abi.buffer, starting_bytes, write);
+
+			wasm_memory_pool_add(&pool->warm_memory, memory);
+			atomic_fetch_add(&pool->warm_memory_count, 1);
+		}
+
+		while (atomic_load(&pool->warm_stack_count) < module->warm_instances) {
+			struct wasm_stack *stack = wasm_stack_alloc(module->stack_size, module->growable_stacks);
+			if (stack == NULL) return;
+
+			numa_topology_bind(stack->buffer, PAGE_SIZE + stack->capacity, node);
+
+			/* Recycled stacks keep the pages nearest high resident, so a warm stack is made just as
+			 * resident */
+			uint64_t resident = (uint64_t)(stack->high - stack->committed);
+			if (resident > WASM_STACK_ZERO_IN_PLACE_PAGES * PAGE_SIZE)
+				resident = WASM_STACK_ZERO_IN_PLACE_PAGES * PAGE_SIZE;
+			module_prefault(stack->high - resident, resident, true);
+
+			wasm_stack_pool_add(&pool->warm_stack, stack);
+			atomic_fetch_add(&pool->warm_stack_count, 1);
+		}
+	}
+}
+
+/**
+ * Unmaps objects from the depot of the calling thread's node, oldest first. Every thread trims its own cache, but the
+ * depot is shared, so only the first thread of the node to get to it in each interval trims it. The objects are
+ * unmapped after the locks are released.
+ * @param module
+ * @param trim_idle unmap the objects that sat in the depot since the last trim
+ * @param under_pressure also unmap the older half of the remaining objects
+ */
+static inline void
+module_trim_depot(struct module *module, bool trim_idle, bool under_pressure)
+{
+	struct module_depot *depot = module_get_depot(module);
+
+	uint64_t now       = __getcycles();
+	uint64_t next_trim = atomic_load(&depot->next_trim);
+	if (now < next_trim) return;
+	if (!atomic_compare_exchange_strong(&depot->next_trim, &next_trim, now + module_pools_trim_interval())) return;
+
+	struct wasm_memory_pool trimmed_memories;
+	struct wasm_stack_pool  trimmed_stacks;
+	wasm_memory_pool_init(&trimmed_memories, false);
+	wasm_stack_pool_init(&trimmed_stacks, false);
+
+	lock_node_t node = {};
+	lock_lock(&depot->memory.lock, &node);
+	uint32_t memories = trim_idle ? depot->memory_idle : 0;
+	if (under_pressure && memories < (depot->memory_count + 1) / 2) memories = (depot->memory_count + 1) / 2;
+	for (uint32_t i = 0; i < memories; i++) {
+		wasm_memory_pool_add_nolock(&trimmed_memories, wasm_memory_pool_remove_oldest_nolock(&depot->memory));
+	}
+	depot->memory_count -= memories;
+	depot->memory_idle = depot->memory_count;
+	lock_unlock(&depot->memory.lock, &node);
+
+	lock_lock(&depot->stack.lock, &node);
+	uint32_t stacks = trim_idle ? depot->stack_idle : 0;
+	if (under_pressure && stacks < (depot->stack_count + 1) / 2) stacks = (depot->stack_count + 1) / 2;
+	for (uint32_t i = 0; i < stacks; i++) {
+		wasm_stack_pool_add_nolock(&trimmed_stacks, wasm_stack_pool_remove_oldest_nolock(&depot->stack));
+	}
+	depot->stack_count -= stacks;
+	depot->stack_idle = depot->stack_count;
+	lock_unlock(&depot->stack.lock, &node);
+
+	/* Unmaps the trimmed objects */
+	wasm_memory_pool_deinit(&trimmed_memories);
+	wasm_stack_pool_deinit(&trimmed_stacks);
+
+	atomic_fetch_sub_explicit(&module_pools_pooled, memories + stacks, memory_order_relaxed);
+	atomic_fetch_add_explicit(under_pressure ? &module_pools_trimmed_pressure_total
+	                                         : &module_pools_trimmed_idle_total,
+	                          memories + stacks, memory_order_relaxed);
+}
+
+/**
+ * Unmaps objects from the calling thread's caches of a module and from the module's depot, oldest first. The warm
+ * pools are left alone, as they hold only what the module's warm-instances target asks for.
+ * @param module
+ * @param trim_idle unmap the objects that sat in the pools since the last trim
+ * @param under_pressure also unmap the older half of the remaining objects and release the pages of those left in
+ * the caches
+ */
+void
+module_trim_pools(struct module *module, bool trim_idle, bool under_pressure)
+{
+	module_trim_depot(module, trim_idle, under_pressure);
+
+	struct module_pool *pool = module_get_pool(module);
+
+	uint32_t memories = trim_idle ? pool->memory_idle : 0;
+	uint32_t stacks   = trim_idle ? pool->stack_idle : 0;
+	if (under_pressure) {
+		if (memories < (pool->memory_count + 1) / 2) memories = (pool->memory_count + 1) / 2;
+		if (stacks < (pool->stack_count + 1) / 2) stacks = (pool->stack_count + 1) / 2;
+	}
+	assert(memories <= pool->memory_count);
+	assert(stacks <= pool->stack_count);
+
+	for (uint32_t i = 0; i < memories; i++) {
+		struct wasm_memory *memory = wasm_memory_pool_remove_oldest_nolock(&pool->memory);
+		assert(memory != NULL);
+		wasm_memory_free(memory);
+	}
+
+	for (uint32_t i = 0; i < stacks; i++) {
+		struct wasm_stack *stack = wasm_stack_pool_remove_oldest_nolock(&pool->stack);
+		assert(stack != NULL);
+		wasm_stack_free(stack);
+	}
+
+	pool->memory_count -= memories;
+	pool->stack_count -= stacks;
+	atomic_fetch_sub_explicit(&module_pools_pooled, memories + stacks, memory_order_relaxed);
+	atomic_fetch_add_explicit(under_pressure ? &module_pools_trimmed_pressure_total
+	                                         : &module_pools_trimmed_idle_total,
+	                          memories + stacks, memory_order_relaxed);
+
+	if (under_pressure) {
+		uint64_t starting_bytes = (uint64_t)module->abi.starting_pages * WASM_PAGE_SIZE;
+		uint64_t released       = 0;
+
+		/* Memories mapped from the snapshot only keep the snapshot's shared pages once recycled */
+		if (module->memory_snapshot.data == NULL && starting_bytes > 0) {
+			struct wasm_memory *memory = NULL;
+			ps_list_foreach_d(&pool->memory.list, memory)
+			{
+				module_release_pages(memory->abi.buffer, memory->abi.size);
+				released++;
+			}
+		}
+
+		struct wasm_stack *stack = NULL;
+		ps_list_foreach_d(&pool->stack.list, stack)
+		{
+			module_release_pages(stack->committed, (size_t)(stack->high - stack->committed));
+			released++;
+		}
+
+		atomic_fetch_add_explicit(&module_pools_released_pressure_total, released, memory_order_relaxed);
+	}
+
+	pool->memory_idle = pool->memory_count;
+	pool->stack_idle  = pool->stack_count;
+}
+
+/**
+ * Checks the resident set size of the runtime against runtime_pool_rss_limit_mb
+ * @returns true if the limit is set and exceeded
+ */
+bool
+module_pools_under_pressure(void)
+{
+	if (runtime_pool_rss_limit_mb == 0) return false;
+
+	int fd = open("/proc/self/statm", O_RDONLY | O_CLOEXEC);
+	if (fd < 0) return false;
+
+	char    buf[128];
+	ssize_t len = read(fd, buf, sizeof(buf) - 1);
+	close(fd);
+	if (len <= 0) return false;
+	buf[len] = '\0';
+
+	/* The second field is the number of resident pages */
+	unsigned long size_pages = 0, resident_pages = 0;
+	if (sscanf(buf, "%lu %lu", &size_pages, &resident_pages) != 2) return false;
+
+	return resident_pages * PAGE_SIZE > (uint64_t)runtime_pool_rss_limit_mb * 1024 * 1024;
+}
+
 /**
  * Module Contructor
  * Allocates and initializes a new module
@@ -0,0 +1,114 @@
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "debuglog.h"
+#include "module.h"
+#include "module_refiller.h"
+#include "panic.h"
+#include "tenant_functions.h"
+
+/* Like the metrics server, the refiller runs on the "reserved OS core" */
+#define MODULE_REFILLER_CORE_ID 0
+
+/* Pools are also checked this often, in case a wakeup was missed */
+#define MODULE_REFILLER_INTERVAL_MS 100
+
+static pthread_t    module_refiller_thread;
+static sem_t        module_refiller_semaphore;
+static _Atomic bool module_refiller_started = false;
+
+static void
+module_refiller_refill_tenant(struct tenant *tenant, void *arg_one, void *arg_two)
+{
+	struct module_database *module_db = &tenant->module_db;
+	for (size_t i = 0; i < module_db->count; i++) {
+		if (module_db->modules[i]->warm_instances > 0) module_refill_warm_pools(module_db->modules[i]);
+	}
+}
+
+static void
+module_refiller_check_tenant(struct tenant *tenant, void *arg_one, void *arg_two)
+{
+	bool                   *has_warm_instances = (bool *)arg_one;
+	struct module_database *module_db          = &tenant->module_db;
+	for (size_t i = 0; i < module_db->count; i++) {
+		if (module_db->modules[i]->warm_instances > 0) *has_warm_instances = true;
+	}
+}
+
+static void *
+module_refiller_main(void *arg)
+{
+	/* Only run when the listener and the metrics server leave the core idle */
+	struct sched_param param = {.sched_priority = 0};
+	int                rc    = pthread_setschedparam(pthread_self(), SCHED_IDLE, &param);
+	if (rc != 0) debuglog("Failed to set refiller to SCHED_IDLE: %s\n", strerror(rc));
+
+	while (true) {
+		tenant_database_foreach(module_refiller_refill_tenant, NULL, NULL);
+
+		struct timespec deadline;
+		clock_gettime(CLOCK_REALTIME, &deadline);
+		deadline.tv_nsec += MODULE_REFILLER_INTERVAL_MS * 1000000L;
+		if (deadline.tv_nsec >= 1000000000L) {
+			deadline.tv_sec += 1;
+			deadline.tv_nsec -= 1000000000L;
+		}
+
+		while (sem_timedwait(&module_refiller_semaphore, &deadline) < 0 && errno == EINTR)
+			;
+
+		/* Collapse wakeups that piled up while refilling into a single pass */
+		while (sem_trywait(&module_refiller_semaphore) == 0)
+			;
+	}
+
+	return NULL;
+}
+
+/**
+ * Starts the refiller if any loaded module has a warm-instances target. Must be called after the tenants are loaded
+ */
+void
+module_refiller_initialize(void)
+{
+	bool has_warm_instances = false;
+	tenant_database_foreach(module_refiller_check_tenant, &has_warm_instances, NULL);
+	if (!has_warm_instances) return;
+
+	if (sem_init(&module_refiller_semaphore, 0, 0) < 0) panic("Failed to initialize refiller semaphore\n");
+
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	cpu_set_t cs;
+	CPU_ZERO(&cs);
+	CPU_SET(MODULE_REFILLER_CORE_ID, &cs);
+	pthread_attr_setaffinity_np(&attr, sizeof(cpu_set_t), &cs);
+
+	int rc = pthread_create(&module_refiller_thread, &attr, module_refiller_main, NULL);
+	if (rc != 0) panic("Failed to start refiller thread: %s\n", strerror(rc));
+	pthread_attr_destroy(&attr);
+
+	atomic_store(&module_refiller_started, true);
+	printf("Started the pool refiller thread\n");
+}
+
+/**
+ * Asks the refiller to top up the warm pools. sem_post is async-signal-safe, so workers may call this from the
+ * scheduler in signal context
+ */
+void
+module_refiller_wakeup(void)
+{
+	if (!atomic_load_explicit(&module_refiller_started, memory_order_relaxed)) return;
+
+	int value = 0;
+	sem_getvalue(&module_refiller_semaphore, &value);
+	if (value == 0) sem_post(&module_refiller_semaphore);
+}
@@ -0,0 +1,140 @@
+#include <linux/mempolicy.h> /* MPOL_PREFERRED */
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "numa_topology.h"
+#include "pretty_print.h"
+
+#define NUMA_TOPOLOGY_SYSFS "/sys/devices/system/node"
+
+uint32_t         numa_topology_node_count                                 = 1;
+uint32_t         numa_topology_node_worker_count[NUMA_TOPOLOGY_MAX_NODES] = {0};
+thread_local int numa_topology_local_node                                 = 0;
+
+/* Kernel id of each dense node, used for mbind */
+static int numa_topology_node_ids[NUMA_TOPOLOGY_MAX_NODES] = {0};
+/* Dense node of each cpu */
+static int numa_topology_cpu_nodes[CPU_SETSIZE] = {0};
+
+/**
+ * Parses a sysfs list such as "0-3,8-11" from a file
+ * @param path
+ * @param set the ids in the list are added to it
+ * @returns 0 on success, -1 if the file could not be read
+ */
+static int
+numa_topology_read_list(const char *path, cpu_set_t *set)
+{
+	FILE *file = fopen(path, "r");
+	if (file == NULL) return -1;
+
+	char list[4096] = {0};
+	char *line      = fgets(list, sizeof(list), file);
+	fclose(file);
+	if (line == NULL) return -1;
+
+	char *cursor = list;
+	while (*cursor != '\0' && *cursor != '\n') {
+		char *end   = NULL;
+		long  first = strtol(cursor, &end, 10);
+		if (end == cursor) return -1;
+
+		long last = first;
+		if (*end == '-') {
+			cursor = end + 1;
+			last   = strtol(cursor, &end, 10);
+			if (end == cursor) return -1;
+		}
+
+		for (long id = first; id <= last && id < CPU_SETSIZE; id++) CPU_SET(id, set);
+
+		cursor = end;
+		if (*cursor == ',') cursor++;
+	}
+
+	return 0;
+}
+
+/**
+ * Reads the NUMA nodes and their cores from sysfs. Must be called before workers are placed and modules loaded
+ */
+void
+numa_topology_initialize(void)
+{
+	char *disable = getenv("SLEDGE_DISABLE_NUMA");
+	if (disable != NULL && strcmp(disable, "false") != 0) {
+		pretty_print_key_disabled("NUMA Placement");
+		return;
+	}
+
+	cpu_set_t online_nodes;
+	CPU_ZERO(&online_nodes);
+	if (numa_topology_read_list(NUMA_TOPOLOGY_SYSFS "/online", &online_nodes) < 0) {
+		pretty_print_key_disabled("NUMA Placement");
+		return;
+	}
+
+	uint32_t node_count = 0;
+	for (int id = 0; id < CPU_SETSIZE; id++) {
+		if (!CPU_ISSET(id, &online_nodes)) continue;
+
+		char path[128];
+		snprintf(path, sizeof(path), NUMA_TOPOLOGY_SYSFS "/node%d/cpulist", id);
+
+		cpu_set_t cpus;
+		CPU_ZERO(&cpus);
+		if (numa_topology_read_list(path, &cpus) < 0 || CPU_COUNT(&cpus) == 0) continue;
+
+		int node = NUMA_TOPOLOGY_MAX_NODES - 1;
+		if (node_count < NUMA_TOPOLOGY_MAX_NODES) {
+			node                         = node_count++;
+			numa_topology_node_ids[node] = id;
+		}
+		for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+			if (CPU_ISSET(cpu, &cpus)) numa_topology_cpu_nodes[cpu] = node;
+		}
+	}
+
+	if (node_count > 0) numa_topology_node_count = node_count;
+
+	if (numa_topology_node_count == 1) {
+		pretty_print_key_disabled("NUMA Placement");
+	} else {
+		pretty_print_key_value("NUMA Nodes", "%u\n", numa_topology_node_count);
+	}
+}
+
+/**
+ * @param cpu
+ * @returns the dense node of the cpu
+ */
+int
+numa_topology_node_of_cpu(int cpu)
+{
+	if (numa_topology_node_count == 1 || cpu < 0 || cpu >= CPU_SETSIZE) return 0;
+	return numa_topology_cpu_nodes[cpu];
+}
+
+/**
+ * Asks the kernel to fault the pages of a mapping in on a node, wherever the faulting thread runs. The policy
+ * belongs to the mapping, so it also covers pages the mapping commits later, but not a mapping that replaces it
+ * @param addr page-aligned start of the mapping
+ * @param length bytes of the mapping
+ * @param node the dense node
+ * @returns 0 on success, -1 on error
+ */
+int
+numa_topology_bind(void *addr, size_t length, int node)
+{
+	if (numa_topology_node_count == 1) return 0;
+
+	int id = numa_topology_node_ids[node];
+	if (id >= sizeof(unsigned long) * 8) return 0;
+
+	unsigned long mask = 1UL << id;
+	return (int)syscall(SYS_mbind, addr, length, MPOL_PREFERRED, &mask, sizeof(mask) * 8 + 1, 0);
+}
@@ -14,7 +14,6 @@
 #include "debuglog.h"
 #include "global_request_scheduler_deque.h"
 #include "global_request_scheduler_minheap.h"
-#include "http_parser_settings.h"
 #include "listener_thread.h"
 #include "module.h"
 #include "runtime.h"
@@ -29,8 +28,10 @@
 
 pthread_t *runtime_worker_threads;
 int       *runtime_worker_threads_argument;
-/* The active deadline of the sandbox running on each worker thread */
-uint64_t *runtime_worker_threads_deadline;
+/* The sandbox running on each worker thread */
+struct runtime_worker_slot *runtime_worker_slots;
+/* The NUMA node of the core each worker thread is pinned to */
+int *runtime_worker_threads_numa_node;
 
 /******************************************
  * Shared Process / Listener Thread Logic *
@@ -42,7 +43,8 @@ runtime_cleanup()
 	sandbox_perf_log_cleanup();
 	http_session_perf_log_cleanup();
 
-	if (runtime_worker_threads_deadline) free(runtime_worker_threads_deadline);
+	if (runtime_worker_slots) free(runtime_worker_slots);
+	if (runtime_worker_threads_numa_node) free(runtime_worker_threads_numa_node);
 	if (runtime_worker_threads_argument) free(runtime_worker_threads_argument);
 	if (runtime_worker_threads) free(runtime_worker_threads);
 
@@ -99,9 +101,11 @@ runtime_initialize(void)
 	assert(runtime_worker_threads != NULL);
 	runtime_worker_threads_argument = calloc(runtime_worker_threads_count, sizeof(int));
 	assert(runtime_worker_threads_argument != NULL);
-	runtime_worker_threads_deadline = malloc(runtime_worker_threads_count * sizeof(uint64_t));
-	assert(runtime_worker_threads_deadline != NULL);
-	memset(runtime_worker_threads_deadline, UINT8_MAX, runtime_worker_threads_count * sizeof(uint64_t));
+	runtime_worker_slots = calloc(runtime_worker_threads_count, sizeof(struct runtime_worker_slot));
+	assert(runtime_worker_slots != NULL);
+	for (int i = 0; i < runtime_worker_threads_count; i++) runtime_worker_slots[i].deadline = UINT64_MAX;
+	runtime_worker_threads_numa_node = calloc(runtime_worker_threads_count, sizeof(int));
+	assert(runtime_worker_threads_numa_node != NULL);
 
 	http_total_init();
 	sandbox_total_initialize();
@@ -109,6 +113,7 @@ runtime_initialize(void)
 
 	/* Setup Scheduler */
 	scheduler_initialize();
+	worker_wakeup_queue_initialize();
 
 	/* Configure Signals */
 	signal(SIGPIPE, SIG_IGN);
@@ -116,7 +121,6 @@ runtime_initialize(void)
 	signal(SIGINT, runtime_cleanup);
 	signal(SIGQUIT, runtime_cleanup);
 
-	http_parser_settings_initialize();
 
 #ifdef ADMISSIONS_CONTROL
 	/* Admissions Control Setup */
@@ -4,6 +4,7 @@
 
 #include "current_sandbox.h"
 #include "debuglog.h"
+#include "object_cache.h"
 #include "panic.h"
 #include "pool.h"
 #include "runtime.h"
@@ -17,6 +18,14 @@
 
 _Atomic uint64_t sandbox_total = 0;
 
+/* Freed sandboxes kept by each thread and in the depot shared by all threads. Sandboxes are usually allocated by a
+ * listener and freed by a worker, so most reach the listener again through the depot. See object_cache.h */
+#define SANDBOX_CACHE_CAPACITY 32
+#define SANDBOX_DEPOT_CAPACITY 1024
+
+INIT_OBJECT_CACHE(sandbox, SANDBOX_CACHE_CAPACITY, SANDBOX_DEPOT_CAPACITY)
+DEFINE_OBJECT_CACHE(sandbox)
+
 static inline void
 sandbox_log_allocation(struct sandbox *sandbox)
 {
@@ -77,7 +86,7 @@ sandbox_free_stack(struct sandbox *sandbox)
 {
 	assert(sandbox);
 
-	return module_free_stack(sandbox->module, sandbox->stack);
+	return module_free_stack(sandbox->module, sandbox->stack, sandbox->numa_node);
 }
 
 /**
@@ -107,6 +116,7 @@ sandbox_prepare_execution_environment(struct sandbox *sandbox)
 	}
 
 	/* Allocate linear memory in a 4GB address space */
+	sandbox->numa_node = numa_topology_local_node;
 	if (sandbox_allocate_linear_memory(sandbox)) {
 		error_message = "failed to allocate sandbox linear memory";
 		goto err_memory_allocation_failed;
@@ -185,11 +195,14 @@ sandbox_alloc(struct module *module, struct http_session *session, struct route
 
 	assert(size_to_alloc % alignment == 0);
 
-	struct sandbox *sandbox = NULL;
-	sandbox                 = aligned_alloc(alignment, size_to_alloc);
+	struct sandbox *sandbox = sandbox_cache_take();
+	if (sandbox == NULL) {
+		sandbox = aligned_alloc(alignment, size_to_alloc);
+		if (unlikely(sandbox == NULL)) return NULL;
+	}
 
-	if (unlikely(sandbox == NULL)) return NULL;
-	memset(sandbox, 0, size_to_alloc);
+	/* Zeroing the arena's header leaves it empty, so its buffer does not need zeroing */
+	memset(sandbox, 0, offsetof(struct sandbox, arena.buffer));
 
 	sandbox_set_as_allocated(sandbox);
 	sandbox_init(sandbox, module, session, route, tenant, admissions_estimate);
@@ -215,7 +228,10 @@ sandbox_deinit(struct sandbox *sandbox)
 
 	if (likely(sandbox->stack != NULL)) sandbox_free_stack(sandbox);
 	if (likely(sandbox->globals.buffer != NULL)) sandbox_free_globals(sandbox);
-	if (likely(sandbox->wasi_context != NULL)) wasi_context_destroy(sandbox->wasi_context);
+
+	/* Frees the WASI context and any scratch a hostcall left behind */
+	sandbox->wasi_context = NULL;
+	arena_reset(&sandbox->arena);
 }
 
 /**
@@ -230,5 +246,5 @@ sandbox_free(struct sandbox *sandbox)
 	assert(sandbox->state == SANDBOX_ERROR || sandbox->state == SANDBOX_COMPLETE);
 
 	sandbox_deinit(sandbox);
-	free(sandbox);
+	if (!sandbox_cache_give(sandbox)) free(sandbox);
 }
@@ -0,0 +1,4 @@
+#include "slab_buffer.h"
+
+/* Per-thread cache of empty slabs */
+thread_local struct slab_pool slab_pool = {.head = NULL, .count = 0};
@@ -1,3 +1,5 @@
+#include <limits.h>
+
 #include "sledge_abi.h"
 #include "current_sandbox.h"
 #include "map.h"
@@ -80,8 +82,9 @@ EXPORT void
 sledge_abi__wasm_memory_initialize_region(struct sledge_abi__wasm_memory *wasm_memory, uint32_t offset,
                                           uint32_t region_size, uint8_t region[])
 {
+	/* Modules also initialize their memory snapshot at load time, when there is no sandbox */
 	struct sandbox *sandbox = current_sandbox_get();
-	assert(sandbox->state == SANDBOX_RUNNING_SYS);
+	assert(sandbox == NULL || sandbox->state == SANDBOX_RUNNING_SYS);
 	wasm_memory_initialize_region((struct wasm_memory *)wasm_memory, offset, region_size, region);
 }
 
@@ -158,6 +161,9 @@ sledge_abi__wasi_snapshot_preview1_args_get(__wasi_size_t argv_retoffset, __wasi
 
 	sandbox_syscall(sandbox);
 
+	/* Host scratch is released back to this mark before returning */
+	struct arena_mark scratch = arena_mark(&sandbox->arena);
+
 	__wasi_size_t       rc   = 0;
 	const __wasi_size_t argc = sandbox->wasi_context->argc;
 	if (unlikely(argc == 0)) { goto done; }
@@ -169,7 +175,7 @@ sledge_abi__wasi_snapshot_preview1_args_get(__wasi_size_t argv_retoffset, __wasi
 
 	/* args_get backings return a vector of host pointers. We need a host buffer to store this
 	 * temporarily before unswizzling and writing to linear memory */
-	char **argv_temp = calloc(argc, sizeof(char *));
+	char **argv_temp = arena_alloc(&sandbox->arena, argc * sizeof(char *));
 	if (unlikely(argv_temp == NULL)) { goto done; }
 
 	/* Writes argv_buf to linear memory and argv vector to our temporary buffer */
@@ -184,10 +190,7 @@ sledge_abi__wasi_snapshot_preview1_args_get(__wasi_size_t argv_retoffset, __wasi
 	}
 
 done:
-	if (likely(argv_temp != NULL)) {
-		free(argv_temp);
-		argv_temp = NULL;
-	}
+	arena_release(&sandbox->arena, scratch);
 	sandbox_return(sandbox);
 
 	return (uint32_t)rc;
@@ -275,6 +278,9 @@ sledge_abi__wasi_snapshot_preview1_environ_get(__wasi_size_t env_retoffset, __wa
 	sandbox_syscall(sandbox);
 	__wasi_errno_t rc = 0;
 
+	/* Host scratch is released back to this mark before returning */
+	struct arena_mark scratch = arena_mark(&sandbox->arena);
+
 	const __wasi_size_t envc = sandbox->wasi_context->envc;
 	if (envc == 0) { goto done; }
 
@@ -285,7 +291,7 @@ sledge_abi__wasi_snapshot_preview1_environ_get(__wasi_size_t env_retoffset, __wa
 	 * these results to environ_temp temporarily before converting to offsets and writing to
 	 * linear memory. We could technically write this to linear memory and then do a "fix up,"
 	 * but this would leak host information and constitue a security issue */
-	char **env_temp = calloc(envc, sizeof(char *));
+	char **env_temp = arena_alloc(&sandbox->arena, envc * sizeof(char *));
 	if (unlikely(env_temp == NULL)) { goto done; }
 
 	__wasi_size_t *env_retptr     = (__wasi_size_t *)get_memory_ptr_for_runtime(env_retoffset,
@@ -299,11 +305,7 @@ sledge_abi__wasi_snapshot_preview1_environ_get(__wasi_size_t env_retoffset, __wa
 	for (int i = 0; i < envc; i++) { env_retptr[i] = env_buf_retoffset + (uint32_t)(env_temp[i] - env_temp[0]); }
 
 done:
-	if (likely(env_temp != NULL)) {
-		free(env_temp);
-		env_temp = NULL;
-	}
-
+	arena_release(&sandbox->arena, scratch);
 	sandbox_return(sandbox);
 	return (uint32_t)rc;
 }
@@ -563,7 +565,8 @@ sledge_abi__wasi_snapshot_preview1_fd_read(__wasi_fd_t fd, __wasi_size_t iovs_ba
 
 	/* Swizzle iovs, writting to temp buffer */
 	check_bounds(iovs_baseoffset, WASI_SERDES_SIZE_iovec_t * iovs_len);
-	__wasi_iovec_t *iovs_baseptr = calloc(iovs_len, sizeof(__wasi_iovec_t));
+	struct arena_mark scratch      = arena_mark(&sandbox->arena);
+	__wasi_iovec_t   *iovs_baseptr = arena_alloc(&sandbox->arena, iovs_len * sizeof(__wasi_iovec_t));
 	if (unlikely(iovs_baseptr == NULL)) { goto done; }
 	rc = wasi_serdes_readv_iovec_t(sandbox->memory->abi.buffer, sandbox->memory->abi.size, iovs_baseoffset,
 	                               iovs_baseptr, iovs_len);
@@ -572,11 +575,7 @@ sledge_abi__wasi_snapshot_preview1_fd_read(__wasi_fd_t fd, __wasi_size_t iovs_ba
 	rc = wasi_snapshot_preview1_backing_fd_read(sandbox->wasi_context, fd, iovs_baseptr, iovs_len, nread_retptr);
 
 done:
-	if (likely(iovs_baseptr != NULL)) {
-		free(iovs_baseptr);
-		iovs_baseptr = NULL;
-	}
-
+	arena_release(&sandbox->arena, scratch);
 	sandbox_return(sandbox);
 	return (uint32_t)rc;
 }
@@ -687,7 +686,8 @@ sledge_abi__wasi_snapshot_preview1_fd_write(__wasi_fd_t fd, __wasi_size_t iovs_b
 
 	/* Swizzle iovs, writting to temporary buffer */
 	check_bounds(iovs_baseoffset, WASI_SERDES_SIZE_ciovec_t * iovs_len);
-	__wasi_ciovec_t *iovs_baseptr = calloc(iovs_len, sizeof(__wasi_ciovec_t));
+	struct arena_mark scratch      = arena_mark(&sandbox->arena);
+	__wasi_ciovec_t  *iovs_baseptr = arena_alloc(&sandbox->arena, iovs_len * sizeof(__wasi_ciovec_t));
 	if (unlikely(iovs_baseptr == NULL)) { goto done; }
 	rc = wasi_serdes_readv_ciovec_t(sandbox->memory->abi.buffer, sandbox->memory->abi.size, iovs_baseoffset,
 	                                iovs_baseptr, iovs_len);
@@ -697,11 +697,8 @@ sledge_abi__wasi_snapshot_preview1_fd_write(__wasi_fd_t fd, __wasi_size_t iovs_b
 	                                             nwritten_retptr);
 
 done:
+	arena_release(&sandbox->arena, scratch);
 	sandbox_return(sandbox);
-	if (likely(iovs_baseptr != NULL)) {
-		free(iovs_baseptr);
-		iovs_baseptr = NULL;
-	}
 
 	return (uint32_t)rc;
 }
@@ -1163,3 +1160,59 @@ sledge_abi__scratch_storage_upsert(uint32_t key_offset, uint32_t key_len, uint32
 
 	sandbox_return(sandbox);
 }
+
+/**
+ * Places the body of the HTTP request in linear memory, returning its offset and length. The first call grows linear
+ * memory by enough pages to hold the body. If the body was received into a memfd_buffer, those pages are mapped
+ * copy-on-write over the new pages, so the body is not copied. Otherwise, the body is copied once. Later calls
+ * return the same region.
+ * @param offset_retoffset linear memory offset where the offset of the body is written
+ * @param length_retoffset linear memory offset where the length of the body is written
+ * @returns 0 on success, 1 on error
+ */
+EXPORT int
+sledge_abi__request_body_get(uint32_t offset_retoffset, uint32_t length_retoffset)
+{
+	int rc = 0;
+
+	struct sandbox *sandbox = current_sandbox_get();
+
+	sandbox_syscall(sandbox);
+
+	/* The body of a streaming request is only placed in linear memory once all of it has arrived */
+	current_sandbox_wait_for_request_body(INT_MAX);
+
+	uint32_t *offset_retptr = (uint32_t *)get_memory_ptr_for_runtime(offset_retoffset, sizeof(uint32_t));
+	uint32_t *length_retptr = (uint32_t *)get_memory_ptr_for_runtime(length_retoffset, sizeof(uint32_t));
+
+	struct http_request *http_request = &sandbox->http->http_request;
+	if (sandbox->request_body_length > 0 || http_request->body_length_read <= 0) goto DONE;
+
+	struct sledge_abi__wasm_memory *memory      = &sledge_abi__current_wasm_module_instance.abi.memory;
+	struct memfd_buffer            *body_buffer = &sandbox->http->request_body_buffer;
+	const uint64_t                  offset      = memory->size;
+	const uint64_t                  length      = (uint64_t)http_request->body_length_read;
+
+	/* Whole wasm pages are added so the guest allocator continues to own everything above the body */
+	uint64_t pages = (length + WASM_PAGE_SIZE - 1) / WASM_PAGE_SIZE;
+	if (unlikely(wasm_memory_expand((struct wasm_memory *)memory, pages * WASM_PAGE_SIZE) < 0)) {
+		rc = 1;
+		goto DONE;
+	}
+	current_sandbox_memory_writeback();
+
+	if (body_buffer->data != NULL && memfd_buffer_map_private(body_buffer, &memory->buffer[offset]) == 0) {
+		sandbox->request_body_mapping_size = body_buffer->capacity;
+	} else {
+		memcpy(&memory->buffer[offset], http_request->body, length);
+	}
+
+	sandbox->request_body_offset = (uint32_t)offset;
+	sandbox->request_body_length = (uint32_t)length;
+
+DONE:
+	*offset_retptr = sandbox->request_body_offset;
+	*length_retptr = sandbox->request_body_length;
+	sandbox_return(sandbox);
+	return rc;
+}
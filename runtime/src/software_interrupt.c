@@ -5,8 +5,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
-#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #include <threads.h>
+#include <time.h>
 #include <ucontext.h>
 #include <unistd.h>
 
@@ -25,52 +27,43 @@
 #include "software_interrupt.h"
 #include "software_interrupt_counts.h"
 
+/* The signal handler runs the scheduler, so give it room beyond MINSIGSTKSZ */
+#define SOFTWARE_INTERRUPT_ALTSTACK_SIZE (256 * 1024)
+
+/* The worker that also runs the process-wide periodic work, such as the MTDS global tenant promotions */
+#define SOFTWARE_INTERRUPT_TIMER_OWNER 0
+
 thread_local _Atomic volatile sig_atomic_t handler_depth    = 0;
 thread_local _Atomic volatile sig_atomic_t deferred_sigalrm = 0;
 
-/***************************************
- * Externs
- **************************************/
+/* The POSIX timer of the worker, which sends SIGALRM to that worker alone */
+thread_local static timer_t software_interrupt_timer;
+thread_local static bool    software_interrupt_timer_created = false;
 
-extern pthread_t *runtime_worker_threads;
+/* Indexed by worker_thread_idx. Set while a tickless worker's timer is disarmed, so other threads know to kick it */
+_Atomic bool *software_interrupt_timer_disarmed = NULL;
+
+/* Indexed by worker_thread_idx. The deadline of the earliest arrival a worker was signaled to preempt for, until its
+ * SIGALRM handler runs, so a burst of arrivals does not signal the same worker again. UINT64_MAX if none */
+_Atomic uint64_t *software_interrupt_arrival_deadline = NULL;
 
 /**************************
  * Private Static Inlines *
  *************************/
 
 /**
- * A POSIX signal is delivered to only one thread.
- * This function broadcasts the sigalarm signal to all other worker threads
+ * Counts a SIGALRM by its origin, the worker's own timer or another thread
  */
 static inline void
-propagate_sigalrm(siginfo_t *signal_info)
+software_interrupt_count_sigalrm(siginfo_t *signal_info)
 {
-	/* Signal was sent directly by the kernel, so forward to other threads */
-	if (signal_info->si_code == SI_KERNEL) {
+	if (signal_info->si_code == SI_TIMER) {
 		software_interrupt_counts_sigalrm_kernel_increment();
-		for (int i = 0; i < runtime_worker_threads_count; i++) {
-			/* All threads should have been initialized */
-			assert(runtime_worker_threads[i] != 0);
-
-			if (pthread_self() == runtime_worker_threads[i]) continue;
-
-			switch (runtime_sigalrm_handler) {
-			case RUNTIME_SIGALRM_HANDLER_TRIAGED: {
-				if (scheduler_worker_would_preempt(i)) pthread_kill(runtime_worker_threads[i], SIGALRM);
-				continue;
-			}
-			case RUNTIME_SIGALRM_HANDLER_BROADCAST: {
-				pthread_kill(runtime_worker_threads[i], SIGALRM);
-				continue;
-			}
-			default: {
-				panic("Unexpected SIGALRM Handler: %d\n", runtime_sigalrm_handler);
-			}
-			}
-		}
 	} else {
 		software_interrupt_counts_sigalrm_thread_increment();
-		/* Signal forwarded from another thread. Just confirm it resulted from pthread_kill */
+		/* Sent by pthread_kill or raise: the worker replaying a SIGALRM it deferred, software_interrupt_kick
+		 * for a sandbox woken while the worker's tickless timer was disarmed, or the listener through
+		 * software_interrupt_preempt_for_arrival */
 		assert(signal_info->si_code == SI_TKILL);
 	}
 }
@@ -113,32 +106,35 @@ software_interrupt_handle_signals(int signal_type, siginfo_t *signal_info, void
 	switch (signal_type) {
 	case SIGALRM: {
 		assert(runtime_preemption_enabled);
+		software_interrupt_count_sigalrm(signal_info);
+
+		if (runtime_arrival_preemption_enabled) {
+			/* Any arrival this worker was signaled for is now up to its scheduler */
+			_Atomic uint64_t *arrival_deadline = &software_interrupt_arrival_deadline[worker_thread_idx];
+			if (atomic_load_explicit(arrival_deadline, memory_order_relaxed) != UINT64_MAX)
+				atomic_store(arrival_deadline, UINT64_MAX);
+		}
+
+		if (scheduler == SCHEDULER_MTDS && worker_thread_idx == SOFTWARE_INTERRUPT_TIMER_OWNER
+		    && signal_info->si_code == SI_TIMER) {
+			/* Global tenant promotions */
+			global_timeout_queue_process_promotions();
+		}
 
 		if (worker_thread_is_running_cooperative_scheduler()) {
 			/* There is no benefit to deferring SIGALRMs that occur when we are already in the cooperative
-			 * scheduler, so just propagate and return */
-			if (scheduler == SCHEDULER_MTDS && signal_info->si_code == SI_KERNEL) {
-				/* Global tenant promotions */
-				global_timeout_queue_process_promotions();
-			}
-			propagate_sigalrm(signal_info);
+			 * scheduler, so just return */
+		} else if (runtime_sigalrm_handler == RUNTIME_SIGALRM_HANDLER_TRIAGED
+		           && !scheduler_worker_would_preempt()) {
+			/* Triaged, and nothing would preempt the current sandbox, so skip the scheduler */
+			scheduler_arm_quantum(current_sandbox);
 		} else if (current_sandbox_is_preemptable()) {
 			/* Preemptable, so run scheduler. The scheduler handles outgoing state changes */
 			sandbox_interrupt(current_sandbox);
-			if (scheduler == SCHEDULER_MTDS && signal_info->si_code == SI_KERNEL) {
-				/* Global tenant promotions */
-				global_timeout_queue_process_promotions();
-			}
-			propagate_sigalrm(signal_info);
 			scheduler_preemptive_sched(interrupted_context);
 		} else {
-			/* We transition the sandbox to an interrupted state to exclude time propagating signals and
-			 * running the scheduler from per-sandbox accounting */
-			if (scheduler == SCHEDULER_MTDS && signal_info->si_code == SI_KERNEL) {
-				/* Global tenant promotions */
-				global_timeout_queue_process_promotions();
-			}
-			propagate_sigalrm(signal_info);
+			/* We transition the sandbox to an interrupted state to exclude time running the scheduler from
+			 * per-sandbox accounting */
 			atomic_fetch_add(&deferred_sigalrm, 1);
 		}
 
@@ -175,8 +171,17 @@ software_interrupt_handle_signals(int signal_type, siginfo_t *signal_info, void
 	case SIGSEGV: {
 		software_interrupt_counts_sigsegv_increment();
 
+		/* A growable stack faulted below its committed pages, so commit more and retry the access. The sandbox
+		 * may be in either user or runtime code, as both run on its stack */
+		if (current_sandbox && current_sandbox->stack
+		    && wasm_stack_grow(current_sandbox->stack, signal_info->si_addr))
+			break;
+
 		if (likely(current_sandbox && current_sandbox->state == SANDBOX_RUNNING_USER)) {
 			atomic_fetch_sub(&handler_depth, 1);
+			struct wasm_stack *stack = current_sandbox->stack;
+			if (stack && wasm_stack_is_guard_page(stack, signal_info->si_addr))
+				current_sandbox_trap(WASM_TRAP_PROTECTED_CALL_STACK_OVERFLOW);
 			current_sandbox_trap(WASM_TRAP_OUT_OF_BOUNDS_LINEAR_MEMORY);
 		} else {
 			panic("Runtime SIGSEGV\n");
@@ -209,43 +214,151 @@ software_interrupt_handle_signals(int signal_type, siginfo_t *signal_info, void
  *******************/
 
 /**
- * Arms the Interval Timer to start in one quantum and then trigger a SIGALRM every quantum
+ * Creates the calling worker's timer. Unless the quantum is tickless, arms it to trigger a SIGALRM every quantum.
+ * The workers' timers are staggered across the quantum, so they do not all enter the scheduler at once
  */
 void
 software_interrupt_arm_timer(void)
 {
 	if (!runtime_preemption_enabled) return;
 
-	struct itimerval interval_timer;
-
-	memset(&interval_timer, 0, sizeof(struct itimerval));
-	interval_timer.it_value.tv_usec    = runtime_quantum_us;
-	interval_timer.it_interval.tv_usec = runtime_quantum_us;
+	if (!software_interrupt_timer_created) {
+		struct sigevent signal_event;
+		memset(&signal_event, 0, sizeof(struct sigevent));
+		signal_event.sigev_notify          = SIGEV_THREAD_ID;
+		signal_event.sigev_signo           = SIGALRM;
+		signal_event._sigev_un._tid        = (pid_t)syscall(SYS_gettid);
+		signal_event.sigev_value.sival_int = worker_thread_idx;
+
+		if (timer_create(CLOCK_MONOTONIC, &signal_event, &software_interrupt_timer) != 0)
+			panic("timer_create: %s\n", strerror(errno));
+		software_interrupt_timer_created = true;
+	}
 
-	int return_code = setitimer(ITIMER_REAL, &interval_timer, NULL);
-	if (return_code) {
-		perror("setitimer");
-		exit(1);
+	/* The scheduler arms the timer of a tickless worker whenever it switches to a sandbox */
+	if (runtime_tickless_enabled) {
+		atomic_store(&software_interrupt_timer_disarmed[worker_thread_idx], true);
+		return;
 	}
+
+	uint64_t quantum_ns = (uint64_t)runtime_quantum_us * 1000;
+	uint64_t offset_ns  = quantum_ns * worker_thread_idx / runtime_worker_threads_count;
+
+	struct itimerspec timer_spec;
+	memset(&timer_spec, 0, sizeof(struct itimerspec));
+	timer_spec.it_value.tv_sec     = (quantum_ns + offset_ns) / 1000000000;
+	timer_spec.it_value.tv_nsec    = (quantum_ns + offset_ns) % 1000000000;
+	timer_spec.it_interval.tv_sec  = quantum_ns / 1000000000;
+	timer_spec.it_interval.tv_nsec = quantum_ns % 1000000000;
+
+	if (timer_settime(software_interrupt_timer, 0, &timer_spec, NULL) != 0)
+		panic("timer_settime: %s\n", strerror(errno));
 }
 
 /**
- * Disarm the Interval Timer
+ * Sets the calling tickless worker's timer to trigger a single SIGALRM
+ * @param quantum_us microseconds until the SIGALRM, or 0 to disarm the timer
+ */
+void
+software_interrupt_set_timer(uint32_t quantum_us)
+{
+	assert(runtime_tickless_enabled);
+	if (!software_interrupt_timer_created) return;
+
+	/* Skip the system call when the timer is already disarmed */
+	_Atomic bool *disarmed = &software_interrupt_timer_disarmed[worker_thread_idx];
+	if (quantum_us == 0 && atomic_load_explicit(disarmed, memory_order_relaxed)) return;
+
+	struct itimerspec timer_spec;
+	memset(&timer_spec, 0, sizeof(struct itimerspec));
+	timer_spec.it_value.tv_sec  = quantum_us / 1000000;
+	timer_spec.it_value.tv_nsec = (quantum_us % 1000000) * 1000;
+
+	/* Ordered before the scheduler checks its wakeup queue again, see software_interrupt_kick */
+	atomic_store_explicit(disarmed, quantum_us == 0, memory_order_seq_cst);
+	if (timer_settime(software_interrupt_timer, 0, &timer_spec, NULL) != 0)
+		panic("timer_settime: %s\n", strerror(errno));
+}
+
+/**
+ * Disarm the calling worker's timer
  */
 void
 software_interrupt_disarm_timer(void)
 {
-	struct itimerval interval_timer;
+	if (!software_interrupt_timer_created) return;
+
+	struct itimerspec timer_spec;
+	memset(&timer_spec, 0, sizeof(struct itimerspec));
 
-	memset(&interval_timer, 0, sizeof(struct itimerval));
-	interval_timer.it_value.tv_sec     = 0;
-	interval_timer.it_interval.tv_usec = 0;
+	if (timer_settime(software_interrupt_timer, 0, &timer_spec, NULL) != 0)
+		panic("timer_settime: %s\n", strerror(errno));
+	if (runtime_tickless_enabled) atomic_store(&software_interrupt_timer_disarmed[worker_thread_idx], true);
+}
+
+/**
+ * Sends a SIGALRM to a tickless worker that runs a sandbox with its timer disarmed, so its scheduler runs and
+ * considers work that was handed to it, such as a woken sandbox. Safe to call from any thread
+ * @param worker_idx
+ */
+void
+software_interrupt_kick(int worker_idx)
+{
+	if (!runtime_tickless_enabled) return;
 
-	int return_code = setitimer(ITIMER_REAL, &interval_timer, NULL);
-	if (return_code) {
-		perror("setitimer");
-		exit(1);
+	/* Pairs with the worker disarming its timer before it checks its wakeup queue, so either the worker sees the
+	 * work handed to it or the caller sees the timer disarmed */
+	atomic_thread_fence(memory_order_seq_cst);
+	if (!atomic_load_explicit(&software_interrupt_timer_disarmed[worker_idx], memory_order_seq_cst)) return;
+
+	/* An idle worker runs its scheduler anyway */
+	if (runtime_worker_slots[worker_idx].deadline == UINT64_MAX) return;
+
+	pthread_kill(runtime_worker_threads[worker_idx], SIGALRM);
+}
+
+/**
+ * Sends a SIGALRM to the worker of a node that runs the sandbox with the latest deadline, if that deadline is later
+ * than the deadline of a request just queued on the node, so the request need not wait for the next quantum. Nothing
+ * is sent while a worker of the node is idle, as it takes the request anyway. Called by the listener after it queues
+ * a request
+ * @param absolute_deadline of the queued request
+ * @param numa_node the node whose global queue holds the request
+ */
+void
+software_interrupt_preempt_for_arrival(uint64_t absolute_deadline, int numa_node)
+{
+	if (!runtime_arrival_preemption_enabled) return;
+
+	int      target        = -1;
+	uint64_t target_latest = absolute_deadline;
+	for (int idx = 0; idx < runtime_worker_threads_count; idx++) {
+		if (runtime_worker_threads_numa_node[idx] != numa_node) continue;
+
+		uint64_t deadline = runtime_worker_slots[idx].deadline;
+		if (deadline == UINT64_MAX) return;
+
+		/* A worker already signaled for an earlier arrival is as good as running it */
+		_Atomic uint64_t *arrival_deadline = &software_interrupt_arrival_deadline[idx];
+		uint64_t          arrival          = atomic_load_explicit(arrival_deadline, memory_order_relaxed);
+		if (arrival < deadline) deadline = arrival;
+
+		if (deadline > target_latest) {
+			target        = idx;
+			target_latest = deadline;
+		}
 	}
+
+	if (target < 0) return;
+
+	/* Another listener may have signaled the worker since it was read, in which case that SIGALRM serves both */
+	uint64_t expected = atomic_load_explicit(&software_interrupt_arrival_deadline[target], memory_order_relaxed);
+	if (expected < absolute_deadline
+	    || !atomic_compare_exchange_strong(&software_interrupt_arrival_deadline[target], &expected,
+	                                       absolute_deadline))
+		return;
+
+	pthread_kill(runtime_worker_threads[target], SIGALRM);
 }
 
 /**
@@ -258,9 +371,10 @@ software_interrupt_initialize(void)
 	struct sigaction signal_action;
 	memset(&signal_action, 0, sizeof(struct sigaction));
 
-	/* All supported signals trigger the same signal handler */
+	/* All supported signals trigger the same signal handler. Handlers run on the alternate stack of the worker, so
+	 * a fault on an exhausted or not yet committed sandbox stack can still be handled */
 	signal_action.sa_sigaction = software_interrupt_handle_signals;
-	signal_action.sa_flags     = SA_SIGINFO | SA_RESTART;
+	signal_action.sa_flags     = SA_SIGINFO | SA_RESTART | SA_ONSTACK;
 
 	/* Mask SIGALRM and SIGUSR1 while the signal handler executes */
 	sigemptyset(&signal_action.sa_mask);
@@ -285,9 +399,34 @@ software_interrupt_initialize(void)
 		}
 	}
 
+	software_interrupt_timer_disarmed = calloc(runtime_worker_threads_count, sizeof(_Atomic bool));
+	if (software_interrupt_timer_disarmed == NULL) panic("Failed to allocate timer states\n");
+
+	software_interrupt_arrival_deadline = malloc(runtime_worker_threads_count * sizeof(_Atomic uint64_t));
+	if (software_interrupt_arrival_deadline == NULL) panic("Failed to allocate arrival deadlines\n");
+	for (int idx = 0; idx < runtime_worker_threads_count; idx++)
+		atomic_init(&software_interrupt_arrival_deadline[idx], UINT64_MAX);
+
 	software_interrupt_counts_alloc();
 }
 
+/**
+ * Gives the calling worker an alternate signal stack. Must be called before the worker unmasks signals
+ */
+void
+software_interrupt_initialize_altstack(void)
+{
+	stack_t altstack;
+	memset(&altstack, 0, sizeof(stack_t));
+
+	altstack.ss_sp = mmap(NULL, SOFTWARE_INTERRUPT_ALTSTACK_SIZE, PROT_READ | PROT_WRITE,
+	                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (altstack.ss_sp == MAP_FAILED) panic("Failed to allocate signal stack: %s\n", strerror(errno));
+	altstack.ss_size = SOFTWARE_INTERRUPT_ALTSTACK_SIZE;
+
+	if (sigaltstack(&altstack, NULL) != 0) panic("sigaltstack: %s\n", strerror(errno));
+}
+
 void
 software_interrupt_cleanup()
 {
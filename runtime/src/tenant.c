@@ -1,26 +1,32 @@
 #include "tenant.h"
 #include "current_sandbox.h"
+#include "slab_buffer.h"
 #include "tenant_functions.h"
 
 /**
- * Start the tenant as a server listening at tenant->port
+ * Start the tenant as a server listening at tenant->port. Every listener thread gets its own socket bound to the
+ * port with SO_REUSEPORT, so the kernel spreads new connections across the listeners.
  * @param tenant
  * @returns 0 on success, -1 on error
  */
 int
 tenant_listen(struct tenant *tenant)
 {
-	int rc = tcp_server_listen(&tenant->tcp_server);
-	if (rc < 0) goto err;
+	int rc        = 0;
+	int listening = 0;
+
+	for (; listening < runtime_listener_threads_count; listening++) {
+		rc = tcp_server_listen(&tenant->tcp_servers[listening]);
+		if (rc < 0) goto err_listen;
+	}
 
 	rc = listener_thread_register_tenant(tenant);
-	if (unlikely(rc < 0)) goto err_add_to_epoll;
+	if (unlikely(rc < 0)) goto err_listen;
 
 done:
 	return rc;
-err_add_to_epoll:
-	tcp_server_close(&tenant->tcp_server);
-err:
+err_listen:
+	for (int i = 0; i < listening; i++) tcp_server_close(&tenant->tcp_servers[i]);
 	rc = -1;
 	goto done;
 }
@@ -42,11 +48,14 @@ tenant_preprocess(struct http_session *session)
 	assert(current_sandbox_get() == NULL);
 	current_sandbox_set(pre_sandbox);
 	current_sandbox_start();
-	auto_buf_flush(&session->response_body);
+	/* The preprocessing module prints a single number */
+	char   output[64];
+	size_t output_length = slab_buffer_copy_out(&session->response_body, output, sizeof(output) - 1);
+	output[output_length] = '\0';
 
 	char *endptr;
-	long  num = strtol(session->response_body.data, &endptr, 10);
-	if (endptr == session->response_body.data) {
+	long  num = strtol(output, &endptr, 10);
+	if (endptr == output) {
 		printf("No digits were found\n");
 	} else if (*endptr != '\0' && *endptr != '\n') {
 		printf("Further characters after number: %s\n", endptr);
@@ -59,7 +68,7 @@ tenant_preprocess(struct http_session *session)
 	session->http_request.cursor = 0;
 	pre_sandbox->http            = NULL;
 	pre_sandbox->state           = SANDBOX_COMPLETE;
-	auto_buf_deinit(&session->response_body);
+	slab_buffer_deinit(&session->response_body);
 	current_sandbox_set(NULL);
 	sandbox_free_linear_memory(pre_sandbox);
 	sandbox_free(pre_sandbox);
@@ -61,7 +61,10 @@ tenant_database_find_by_socket_descriptor(int socket_descriptor)
 {
 	for (size_t i = 0; i < tenant_database_count; i++) {
 		assert(tenant_database[i]);
-		if (tenant_database[i]->tcp_server.socket_descriptor == socket_descriptor) return tenant_database[i];
+		for (int j = 0; j < runtime_listener_threads_count; j++) {
+			if (tenant_database[i]->tcp_servers[j].socket_descriptor == socket_descriptor)
+				return tenant_database[i];
+		}
 	}
 	return NULL;
 }
@@ -76,7 +79,7 @@ tenant_database_find_by_port(uint16_t port)
 {
 	for (size_t i = 0; i < tenant_database_count; i++) {
 		assert(tenant_database[i]);
-		if (tenant_database[i]->tcp_server.port == port) return tenant_database[i];
+		if (tenant_database[i]->tcp_servers[0].port == port) return tenant_database[i];
 	}
 	return NULL;
 }
@@ -95,10 +98,10 @@ tenant_database_find_by_ptr(void *ptr)
 }
 
 void
-tenant_database_foreach(void (*cb)(struct tenant *, void *), void *arg)
+tenant_database_foreach(void (*cb)(struct tenant *, void *, void *), void *arg_one, void *arg_two)
 {
 	for (size_t i = 0; i < tenant_database_count; i++) {
 		assert(tenant_database[i]);
-		cb(tenant_database[i], arg);
+		cb(tenant_database[i], arg_one, arg_two);
 	}
 }
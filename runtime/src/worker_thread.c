@@ -11,6 +11,7 @@
 #include "local_runqueue.h"
 #include "local_runqueue_list.h"
 #include "local_runqueue_minheap.h"
+#include "numa_topology.h"
 #include "panic.h"
 #include "priority_queue.h"
 #include "runtime.h"
@@ -30,6 +31,49 @@ thread_local int worker_thread_idx;
 
 /* Used to track tenants' timeouts */
 thread_local struct priority_queue *worker_thread_timeout_queue;
+
+/* Cycle count at which the worker next trims its module pools */
+thread_local static uint64_t worker_thread_next_pool_trim = 0;
+
+/************************
+ * Module Pool Trimming *
+ ***********************/
+
+static void
+worker_thread_trim_tenant_pools(struct tenant *tenant, void *trim_idle, void *under_pressure)
+{
+	struct module_database *module_db = &tenant->module_db;
+	for (size_t i = 0; i < module_db->count; i++) {
+		/* Preprocessing modules are pooled by the listeners */
+		if (module_db->modules[i]->type != APP_MODULE) continue;
+		module_trim_pools(module_db->modules[i], *(bool *)trim_idle, *(bool *)under_pressure);
+	}
+}
+
+/**
+ * Trims the worker's module pools once per SLEDGE_POOL_IDLE_TRIM_MS, unmapping the objects that went unused since
+ * the last trim, and shrinks them further when the runtime is over SLEDGE_POOL_RSS_LIMIT_MB. Called from the idle
+ * loop, where no sandbox is using the pools.
+ */
+void
+worker_thread_trim_pools(void)
+{
+	if (runtime_pool_idle_trim_ms == 0 && runtime_pool_rss_limit_mb == 0) return;
+
+	/* The interval is converted to cycles, which needs the processor speed measured at startup */
+	if (unlikely(runtime_processor_speed_MHz == 0)) return;
+
+	uint64_t now = __getcycles();
+	if (now < worker_thread_next_pool_trim) return;
+
+	worker_thread_next_pool_trim = now + module_pools_trim_interval();
+
+	bool trim_idle      = runtime_pool_idle_trim_ms > 0;
+	bool under_pressure = module_pools_under_pressure();
+	if (!trim_idle && !under_pressure) return;
+
+	tenant_database_foreach(worker_thread_trim_tenant_pools, &trim_idle, &under_pressure);
+}
 /***********************
  * Worker Thread Logic *
  **********************/
@@ -46,7 +90,8 @@ worker_thread_main(void *argument)
 	worker_thread_base_context.variant = ARCH_CONTEXT_VARIANT_RUNNING;
 
 	/* Index was passed via argument */
-	worker_thread_idx = *(int *)argument;
+	worker_thread_idx        = *(int *)argument;
+	numa_topology_local_node = runtime_worker_threads_numa_node[worker_thread_idx];
 
 	/* Set my priority */
 	// runtime_set_pthread_prio(pthread_self(), 2);
@@ -62,6 +107,7 @@ worker_thread_main(void *argument)
 		                                                        tenant_timeout_get_priority);
 	}
 
+	software_interrupt_initialize_altstack();
 	software_interrupt_unmask_signal(SIGFPE);
 	software_interrupt_unmask_signal(SIGSEGV);
 
@@ -69,6 +115,7 @@ worker_thread_main(void *argument)
 	if (runtime_preemption_enabled) {
 		software_interrupt_unmask_signal(SIGALRM);
 		software_interrupt_unmask_signal(SIGUSR1);
+		software_interrupt_arm_timer();
 	}
 
 	scheduler_idle_loop();
@@ -0,0 +1,13 @@
+#include <stdlib.h>
+
+#include "panic.h"
+#include "worker_wakeup_queue.h"
+
+struct worker_wakeup_queue *worker_wakeup_queues = NULL;
+
+void
+worker_wakeup_queue_initialize(void)
+{
+	worker_wakeup_queues = calloc(runtime_worker_threads_count, sizeof(struct worker_wakeup_queue));
+	if (worker_wakeup_queues == NULL) panic("Failed to allocate worker wakeup queues\n");
+}
@@ -0,0 +1,140 @@
+#!/bin/bash
+
+__run_sh__base_path="$(dirname "$(realpath --logical "${BASH_SOURCE[0]}")")"
+__run_sh__bash_libraries_relative_path="../bash_libraries"
+__run_sh__bash_libraries_absolute_path=$(cd "$__run_sh__base_path" && cd "$__run_sh__bash_libraries_relative_path" && pwd)
+export PATH="$__run_sh__bash_libraries_absolute_path:$PATH"
+
+source csv_to_dat.sh || exit 1
+source framework.sh || exit 1
+source get_result_count.sh || exit 1
+source panic.sh || exit 1
+source path_join.sh || exit 1
+source percentiles_table.sh || exit 1
+source validate_dependencies.sh || exit 1
+
+# Compares 4KB pages against transparent huge pages by sending the same workloads to two tenants that only differ
+# by the huge-pages route option
+
+run_functional_tests() {
+	local hostname="$1"
+	local results_directory="$2"
+
+	printf "Func Tests: \n"
+
+	for tenant in "${tenants[@]}"; do
+		curl -H 'Expect:' -H "Content-Type: image/bmp" --data-binary "@${cifar10_image}" -s "${hostname}:${port[$tenant]}/cifar10" >> "${results_directory}/cifar10_${tenant}.txt" || return 1
+		curl -H 'Expect:' -H "Content-Type: image/jpg" --data-binary "@${resize_image}" -s --output /dev/null "${hostname}:${port[$tenant]}/resize" || return 1
+	done
+
+	if ! diff -q "${results_directory}/cifar10_small_pages.txt" "${results_directory}/cifar10_huge_pages.txt" > /dev/null; then
+		echo "cifar10 results differ between tenants" >> "${results_directory}/result.txt"
+		return 1
+	fi
+
+	printf "[OK]\n"
+}
+
+run_perf_tests() {
+	local hostname="$1"
+	local results_directory="$2"
+
+	local -ir total_iterations=500
+	local -ir worker_max=10
+	local -ir batch_size=10
+	local -i batch_id=0
+	local pids
+
+	printf "Perf Tests: \n"
+	for tenant in "${tenants[@]}"; do
+		for workload in "${workloads[@]}"; do
+			batch_id=0
+			for ((i = 0; i < total_iterations; i += batch_size)); do
+				# Block waiting for a worker to finish if we are at our max
+				while (($(pgrep --count hey) >= worker_max)); do
+					wait -n "$(pgrep hey | tr '\n' ' ')"
+				done
+				((batch_id++))
+
+				hey -disable-compression -disable-keepalive -disable-redirects -n $batch_size -c 1 -cpus 1 -t 0 -o csv -m POST -D "${body[$workload]}" "http://${hostname}:${port[$tenant]}/${workload}" > "$results_directory/${workload}_${tenant}_${batch_id}.csv" 2> /dev/null &
+			done
+			pids=$(pgrep hey | tr '\n' ' ')
+			[[ -n $pids ]] && wait -f $pids
+		done
+	done
+	printf "[OK]\n"
+
+	for tenant in "${tenants[@]}"; do
+		for workload in "${workloads[@]}"; do
+			tail --quiet -n +2 "$results_directory/${workload}_${tenant}"_*.csv >> "$results_directory/${workload}_${tenant}.csv"
+			rm "$results_directory/${workload}_${tenant}"_*.csv
+		done
+	done
+}
+
+# Process the experimental results and generate human-friendly results for success rate, throughput, and latency
+process_results() {
+	if (($# != 1)); then
+		error_msg "invalid number of arguments ($#, expected 1)"
+		return 1
+	elif ! [[ -d "$1" ]]; then
+		error_msg "directory $1 does not exist"
+		return 1
+	fi
+
+	local -r results_directory="$1"
+
+	printf "Processing Results: \n"
+
+	# Write headers to CSVs
+	percentiles_table_header "$results_directory/latency.csv"
+
+	for workload in "${workloads[@]}"; do
+		for tenant in "${tenants[@]}"; do
+			# Filter on 200s, subtract DNS time, convert from s to ms, and sort
+			awk -F, '$7 == 200 {print (($1 - $2) * 1000)}' < "$results_directory/${workload}_${tenant}.csv" \
+				| sort -g > "$results_directory/${workload}_${tenant}-response.csv"
+
+			oks=$(wc -l < "$results_directory/${workload}_${tenant}-response.csv")
+			((oks == 0)) && continue # If all errors, skip line
+
+			percentiles_table_row "$results_directory/${workload}_${tenant}-response.csv" "$results_directory/latency.csv" "${workload}_${tenant}"
+
+			# Delete scratch file used for sorting/counting
+			rm -rf "$results_directory/${workload}_${tenant}-response.csv"
+		done
+	done
+
+	# Transform csvs to dat files for gnuplot
+	csv_to_dat "$results_directory/latency.csv"
+
+	printf "[OK]\n"
+	return 0
+}
+
+experiment_client() {
+	local -r hostname="$1"
+	local -r results_directory="$2"
+
+	run_functional_tests "$hostname" "$results_directory" || return 1
+	run_perf_tests "$hostname" "$results_directory" || return 1
+	process_results "$results_directory" || return 1
+}
+
+validate_dependencies curl hey
+
+declare -ar tenants=(small_pages huge_pages)
+declare -Ar port=(
+	[small_pages]=10000
+	[huge_pages]=10001
+)
+
+declare -ar workloads=(cifar10 resize)
+declare -r cifar10_image="$(realpath ../../applications/wasm_apps/CMSIS_5_NN/images/bmp/airplane1.bmp)"
+declare -r resize_image="$(realpath ../sod/image_resize/by_resolution/shrinking_man_large.jpg)"
+declare -Ar body=(
+	[cifar10]="$cifar10_image"
+	[resize]="$resize_image"
+)
+
+framework_init "$@"